@@ -0,0 +1,8 @@
+# lowpass for the speaker, see minarch_audio_filter
+filters = 1
+filter0 = iir
+
+iir_frequency = 8600.0
+iir_quality = 0.707
+iir_gain = 6.0
+iir_type = LPF
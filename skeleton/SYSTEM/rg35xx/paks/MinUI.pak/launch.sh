@@ -30,6 +30,8 @@ echo userspace > /sys/devices/system/cpu/cpu0/cpufreq/scaling_governor
 # Enable core 0 and 1 (but use 0 only)
 echo 0x3 > /sys/devices/system/cpu/autoplug/plug_mask
 echo 0 > /sys/devices/system/cpu/cpu1/online
+# or leave cpu1 up so minarch's Threaded Present pins its thread there
+#echo 1 > /sys/devices/system/cpu/cpu1/online
 
 #######################################
 
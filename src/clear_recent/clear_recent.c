@@ -36,7 +36,7 @@ int main(int argc, char* argv[]) {
         } else if (PAD_justPressed(BTN_B)) {
             quit = 1;
         } else {
-            GFX_sync();
+            GFX_idle();
         }
     }
 
@@ -41,7 +41,7 @@ int main(int argc , char* argv[]) {
 #define CHAR_SLASH 10
 #define CHAR_COLON 11
 	while (c = chars[i]) {
-		digit = TTF_RenderUTF8_Blended(font.large, c, COLOR_WHITE);
+		digit = GFX_renderText(font.large, c, COLOR_WHITE);
 		int y = i==CHAR_COLON ? -3 : 0; // : sits too low naturally
 		SDL_BlitSurface(digit, NULL, digits, &(SDL_Rect){ (i * DIGIT_WIDTH) + (DIGIT_WIDTH - digit->w)/2, y + (DIGIT_HEIGHT - digit->h)/2});
 		SDL_FreeSurface(digit);
@@ -282,7 +282,7 @@ int main(int argc , char* argv[]) {
 			int ampm_w;
 			if (!show_24hour) {
 				x += 20; // space
-				SDL_Surface* text = TTF_RenderUTF8_Blended(font.large, am_selected ? "AM" : "PM", COLOR_WHITE);
+				SDL_Surface* text = GFX_renderText(font.large, am_selected ? "AM" : "PM", COLOR_WHITE);
 				ampm_w = text->w + 4;
 				SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){x,y-6});
 				SDL_FreeSurface(text);
@@ -300,7 +300,7 @@ int main(int argc , char* argv[]) {
 			GFX_flip(screen);
 			dirty = 0;
 		}
-		else GFX_sync();
+		else GFX_idle();
 	}
 	
 	SDL_FreeSurface(digits);
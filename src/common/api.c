@@ -3,6 +3,11 @@
 #include <linux/fb.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -24,6 +29,17 @@
 #include "api.h"
 #include "utils.h"
 #include "defines.h"
+#include "trace.h"
+
+#ifdef HAVE_SINC_RESAMPLER
+#include <audio/audio_resampler.h> // from minarch's libretro-common
+#endif
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+#ifdef HAVE_DSP_FILTER
+#include <audio/dsp_filter.h> // from minarch's libretro-common
+#endif
 
 ///////////////////////////////
 
@@ -63,7 +79,7 @@ typedef struct ion_alloc_info {
 	void*				padd;
 	void*				vadd;
 } ion_alloc_info_t;
-static void ion_alloc(int fd_ion, ion_alloc_info_t* info) {
+static int ion_alloc(int fd_ion, ion_alloc_info_t* info) { // returns 0 on success, info is untouched on failure
 	struct ion_allocation_data	iad;
 	struct ion_fd_data		ifd;
 	struct ion_custom_data		icd;
@@ -73,19 +89,40 @@ static void ion_alloc(int fd_ion, ion_alloc_info_t* info) {
 	iad.align = sysconf(_SC_PAGESIZE);
 	iad.heap_id_mask = (1<<ION_HEAP_ID_PMEM);
 	iad.flags = 0;
-	if (ioctl(fd_ion, ION_IOC_ALLOC, &iad)<0) fprintf(stderr, "ION_ALLOC failed %s\n",strerror(errno));
+	if (ioctl(fd_ion, ION_IOC_ALLOC, &iad)<0) {
+		fprintf(stderr, "ION_ALLOC failed %s\n",strerror(errno));
+		return -1;
+	}
+	
+	struct ion_handle_data ihd;
+	ihd.handle = iad.handle;
 	icd.cmd = OWL_ION_GET_PHY;
 	icd.arg = (uintptr_t)&ipd;
 	ipd.handle = iad.handle;
-	if (ioctl(fd_ion, ION_IOC_CUSTOM, &icd)<0) printf("ION_GET_PHY failed %s\n",strerror(errno));
+	if (ioctl(fd_ion, ION_IOC_CUSTOM, &icd)<0) {
+		fprintf(stderr, "ION_GET_PHY failed %s\n",strerror(errno));
+		ioctl(fd_ion, ION_IOC_FREE, &ihd);
+		return -1;
+	}
 	ifd.handle = iad.handle;
-	if (ioctl(fd_ion, ION_IOC_MAP, &ifd)<0) fprintf(stderr, "ION_MAP failed %s\n",strerror(errno));
+	if (ioctl(fd_ion, ION_IOC_MAP, &ifd)<0) {
+		fprintf(stderr, "ION_MAP failed %s\n",strerror(errno));
+		ioctl(fd_ion, ION_IOC_FREE, &ihd);
+		return -1;
+	}
+	void* vadd = mmap(0, info->size, PROT_READ|PROT_WRITE, MAP_SHARED, ifd.fd, 0);
+	if (vadd==MAP_FAILED) {
+		fprintf(stderr, "ION mmap failed %s\n",strerror(errno));
+		close(ifd.fd);
+		ioctl(fd_ion, ION_IOC_FREE, &ihd);
+		return -1;
+	}
 
 	info->handle = (void*)iad.handle;
 	info->fd = ifd.fd;
 	info->padd = (void*)ipd.phys_addr;
-	info->vadd = mmap(0, info->size, PROT_READ|PROT_WRITE, MAP_SHARED, info->fd, 0);
-
+	info->vadd = vadd;
+	return 0;
 }
 static void ion_free(int fd_ion, ion_alloc_info_t* info) {
 	struct ion_handle_data	ihd;
@@ -307,11 +344,25 @@ static struct GFX_Context {
 	struct fb_var_screeninfo vinfo;
 	ion_alloc_info_t fb_info;
 	
-	int page;
+	// pages cycle back -> pending -> latching -> front
+	int page; // back, being drawn
+	int pending; // handed to the present thread but not presented yet, -1 if none
+	int latching; // presented without a vsync wait so maybe not on screen yet, -1 if none
+	int front; // on screen
+	int last; // most recently flipped
+	uint32_t page_size; // only grows, see GFX_reservePages()
+	uint32_t page_limit; // largest page_size worth trying, drops to page_size once PMEM runs out
 	int width;
 	int height;
 	int pitch;
-	int cleared;
+	int cleared; // mask of pages to clear once they're offscreen
+	
+	int threaded; // GFX_flip() hands pages to GFX_presentThread()
+	pthread_t present_pt;
+	pthread_mutex_t present_mx;
+	pthread_cond_t present_cv;
+	int present_wait; // wait for vsync after swapping
+	int present_quit;
 } gfx;
 
 static SDL_Rect asset_rects[] = {
@@ -343,6 +394,23 @@ static SDL_Rect asset_rects[] = {
 };
 static uint32_t asset_rgbs[ASSET_COLORS];
 GFX_Fonts font;
+struct GFX_Font {
+	int size;
+	TTF_Font* ttf; // NULL until something outside the font atlas needs it
+};
+static GFX_Font gfx_fonts[4];
+static TTF_Font* GFX_openFont(GFX_Font* font) {
+	if (!font->ttf) {
+		TRACE_BEGIN("TTF_OpenFont");
+		font->ttf = TTF_OpenFont(FONT_PATH, font->size);
+		TRACE_END("TTF_OpenFont");
+	}
+	return font->ttf;
+}
+static void GFX_initAtlas(void);
+static void GFX_quitAtlas(void);
+static void GFX_initGlyphs(int i, GFX_Font* font);
+static void GFX_quitGlyphs(void);
 
 ///////////////////////////////
 
@@ -354,6 +422,8 @@ static struct POW_Context {
 	int is_charging;
 	int charge;
 	int should_warn;
+	uint32_t battery_at; // SDL_GetTicks() of the last POW_updateBatteryStatus()
+	uint32_t update_at; // next time POW_update() has something to do, 0 if it isn't being called
 
 	struct owlfb_overlay_args oargs;
 	struct owlfb_overlay_info oinfo;
@@ -367,6 +437,8 @@ static struct POW_Context {
 static int _;
 
 SDL_Surface* GFX_init(int mode) {
+	TRACE_SCOPE("GFX_init");
+	
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_ShowCursor(0);
 	SDL_SetVideoMode(0,0,FIXED_DEPTH,0);
@@ -382,14 +454,22 @@ SDL_Surface* GFX_init(int mode) {
 	ioctl(gfx.fd_fb, FBIOGET_VSCREENINFO, &gfx.vinfo);
 	
 	gfx.page = 1;
+	gfx.pending = -1;
+	gfx.latching = -1;
+	gfx.front = 0;
+	gfx.last = 0;
+	pthread_mutex_init(&gfx.present_mx, NULL);
+	pthread_cond_init(&gfx.present_cv, NULL);
 	gfx.width = FIXED_WIDTH;
 	gfx.height = FIXED_HEIGHT;
 	gfx.pitch = FIXED_PITCH;
 	
-	gfx.fb_info.size = PAGE_SIZE * PAGE_COUNT;
-	ion_alloc(gfx.fd_ion, &gfx.fb_info);
+	gfx.page_size = FIXED_SIZE; // GFX_resize() grows it when a scaler needs more
+	gfx.page_limit = UINT32_MAX; // until an allocation fails
+	gfx.fb_info.size = gfx.page_size * PAGE_COUNT;
+	if (ion_alloc(gfx.fd_ion, &gfx.fb_info)) LOG_error("unable to allocate %i bytes of pages\n", gfx.fb_info.size);
 
-	gfx.screen = SDL_CreateRGBSurfaceFrom(gfx.fb_info.vadd+PAGE_SIZE, gfx.width,gfx.height,FIXED_DEPTH,gfx.pitch, RGBA_MASK_AUTO);
+	gfx.screen = SDL_CreateRGBSurfaceFrom(gfx.fb_info.vadd+gfx.page_size, gfx.width,gfx.height,FIXED_DEPTH,gfx.pitch, RGBA_MASK_AUTO);
 	memset(gfx.screen->pixels, 0, gfx.pitch * gfx.height);
 	
 	struct owlfb_sync_info sinfo;
@@ -403,7 +483,7 @@ SDL_Surface* GFX_init(int mode) {
 	gfx.de_mem[DE_OVL_ISIZE(0)/4] = gfx.de_mem[DE_OVL_ISIZE(2)/4] = ((gfx.width-1) & 0xFFFF) | ((gfx.height-1) << 16);
 	gfx.de_mem[DE_OVL_SR(0)/4] = gfx.de_mem[DE_OVL_SR(2)/4] = ((0x2000*gfx.width/vw)&0xFFFF) | ((0x2000*gfx.height/vh)<<16);
 	gfx.de_mem[DE_OVL_STR(0)/4] = gfx.de_mem[DE_OVL_STR(2)/4] = gfx.pitch / 8;
-	gfx.de_mem[DE_OVL_BA0(0)/4] = (uintptr_t)(gfx.fb_info.padd + PAGE_SIZE);
+	gfx.de_mem[DE_OVL_BA0(0)/4] = (uintptr_t)(gfx.fb_info.padd + gfx.page_size);
 	
 	GFX_setNearestNeighbor(0);
 	
@@ -437,23 +517,40 @@ SDL_Surface* GFX_init(int mode) {
 	gfx.assets = IMG_Load(asset_path);
 	
 	TTF_Init();
-	font.large 	= TTF_OpenFont(FONT_PATH, SCALE1(FONT_LARGE));
-	font.medium = TTF_OpenFont(FONT_PATH, SCALE1(FONT_MEDIUM));
-	font.small 	= TTF_OpenFont(FONT_PATH, SCALE1(FONT_SMALL));
-	font.tiny 	= TTF_OpenFont(FONT_PATH, SCALE1(FONT_TINY));
+	gfx_fonts[0].size = SCALE1(FONT_LARGE);
+	gfx_fonts[1].size = SCALE1(FONT_MEDIUM);
+	gfx_fonts[2].size = SCALE1(FONT_SMALL);
+	gfx_fonts[3].size = SCALE1(FONT_TINY);
+	font.large 	= &gfx_fonts[0];
+	font.medium = &gfx_fonts[1];
+	font.small 	= &gfx_fonts[2];
+	font.tiny 	= &gfx_fonts[3];
+	
+	GFX_initAtlas();
+	GFX_initGlyphs(0, font.large);
+	GFX_initGlyphs(1, font.medium);
+	GFX_initGlyphs(2, font.small);
+	GFX_initGlyphs(3, font.tiny);
 	
 	return gfx.screen;
 }
 
 void GFX_quit(void) {
-	TTF_CloseFont(font.large);
-	TTF_CloseFont(font.medium);
-	TTF_CloseFont(font.small);
-	TTF_CloseFont(font.tiny);
+	GFX_clearTextCache();
+	GFX_quitGlyphs();
+	GFX_quitAtlas();
+	
+	for (int i=0; i<4; i++) {
+		if (gfx_fonts[i].ttf) TTF_CloseFont(gfx_fonts[i].ttf);
+		gfx_fonts[i].ttf = NULL;
+	}
 	
 	SDL_FreeSurface(gfx.assets);
 	
+	GFX_setThreaded(0);
 	GFX_clearAll();
+	pthread_cond_destroy(&gfx.present_cv);
+	pthread_mutex_destroy(&gfx.present_mx);
 
 	ion_free(gfx.fd_ion, &gfx.fb_info);
 	munmap(gfx.de_mem, DE_SIZE);
@@ -466,11 +563,14 @@ void GFX_quit(void) {
 
 void GFX_clear(SDL_Surface* screen) {
 	// this buffer is offscreen when cleared
-	memset(screen->pixels, 0, PAGE_SIZE); 
+	memset(screen->pixels, 0, gfx.page_size); 
 }
+static void GFX_drainPresent(void);
 void GFX_clearAll(void) {
+	GFX_drainPresent(); // nothing stale goes up after this
+	GFX_waitPage();
 	GFX_clear(gfx.screen); // clear backbuffer
-	gfx.cleared = 1; // defer clearing frontbuffer until offscreen
+	gfx.cleared = ((1 << PAGE_COUNT) - 1) & ~(1 << gfx.page); // defer clearing the rest until offscreen
 }
 
 void GFX_setMode(int mode) {
@@ -488,13 +588,54 @@ static uint32_t frame_start = 0;
 void GFX_startFrame(void) {
 	frame_start = SDL_GetTicks();
 }
+// pages start at FIXED_SIZE and grow in whole screens as scalers ask for more
+// but never shrink, so a core flipping between resolutions settles on one
+// allocation instead of churning (and fragmenting) PMEM
+#define PAGE_STEP FIXED_SIZE
+static void GFX_waitVsync(void);
+static int GFX_reservePages(uint32_t size, ion_alloc_info_t* old) { // returns 1 if the pages moved, -1 if they couldn't
+	size = CEIL_DIV(size, PAGE_STEP) * PAGE_STEP;
+	if (size<=gfx.page_size) return 0;
+	if (size>gfx.page_limit) return -1;
+	
+	GFX_drainPresent(); // the present thread can't be holding an old page
+	
+	// the old pages stay on screen until the new ones are mapped so both sets
+	// are held for a moment, if PMEM can't fit that keep the old ones
+	LOG_info("growing pages from %i to %i bytes\n", gfx.page_size, size);
+	ion_alloc_info_t info = gfx.fb_info;
+	info.size = size * PAGE_COUNT;
+	if (ion_alloc(gfx.fd_ion, &info)) {
+		LOG_warn("unable to grow pages, staying at %i bytes\n", gfx.page_size);
+		gfx.page_limit = gfx.page_size;
+		return -1;
+	}
+	*old = gfx.fb_info;
+	gfx.fb_info = info;
+	gfx.page_size = size;
+	gfx.cleared = ((1 << PAGE_COUNT) - 1) & ~(1 << gfx.page); // whatever was in the new ones
+	return 1;
+}
+uint32_t GFX_getReserved(void) {
+	return gfx.fb_info.size;
+}
+uint32_t GFX_getPageLimit(void) {
+	return MIN(gfx.page_limit, PAGE_SIZE);
+}
 SDL_Surface* GFX_resize(int w, int h, int pitch) {
+	GFX_drainPresent(); // don't race the present thread for the DE
+	GFX_waitPage();
+	
+	ion_alloc_info_t old;
+	int moved = GFX_reservePages(pitch * h, &old);
+	if (moved<0) return NULL; // gfx.screen is still the old size
+	
 	gfx.width = w;
 	gfx.height = h;
 	gfx.pitch = pitch;
 
 	SDL_FreeSurface(gfx.screen);
-	gfx.screen = SDL_CreateRGBSurfaceFrom(gfx.fb_info.vadd + gfx.page*PAGE_SIZE, gfx.width,gfx.height,FIXED_DEPTH,gfx.pitch, RGBA_MASK_AUTO);
+	gfx.screen = SDL_CreateRGBSurfaceFrom(gfx.fb_info.vadd + gfx.page*gfx.page_size, gfx.width,gfx.height,FIXED_DEPTH,gfx.pitch, RGBA_MASK_AUTO);
 	memset(gfx.screen->pixels, 0, gfx.pitch * gfx.height);
 	
 	int vw = (gfx.de_mem[DE_PATH_SIZE(0)/4]&0xFFFF)+1;
@@ -503,7 +644,12 @@ SDL_Surface* GFX_resize(int w, int h, int pitch) {
 	gfx.de_mem[DE_OVL_ISIZE(0)/4] = gfx.de_mem[DE_OVL_ISIZE(2)/4] = ((gfx.width-1) & 0xFFFF) | ((gfx.height-1) << 16);
 	gfx.de_mem[DE_OVL_SR(0)/4] = gfx.de_mem[DE_OVL_SR(2)/4] = ((0x2000*gfx.width/vw)&0xFFFF) | ((0x2000*gfx.height/vh)<<16);
 	gfx.de_mem[DE_OVL_STR(0)/4] = gfx.de_mem[DE_OVL_STR(2)/4] = gfx.pitch / 8;
-	gfx.de_mem[DE_OVL_BA0(0)/4] = (uintptr_t)(gfx.fb_info.padd + gfx.page * PAGE_SIZE);
+	gfx.de_mem[DE_OVL_BA0(0)/4] = (uintptr_t)(gfx.fb_info.padd + gfx.page * gfx.page_size);
+	
+	if (moved) {
+		GFX_waitVsync(); // let the DE latch the new page before the old ones go
+		ion_free(gfx.fd_ion, &old);
+	}
 	
 	return gfx.screen;
 }
@@ -518,25 +664,144 @@ void GFX_setNearestNeighbor(int enabled) {
 	DE_setScaleCoef(gfx.de_mem, 3, scale_coef);
 }
 static void POW_flipOverlay(void);
-void GFX_flip(SDL_Surface* screen) {
-	gfx.de_mem[DE_OVL_BA0(0)/4] = gfx.de_mem[DE_OVL_BA0(2)/4] = (uintptr_t)(gfx.fb_info.padd + gfx.page * PAGE_SIZE);
+static void GFX_present(int page) {
+	gfx.de_mem[DE_OVL_BA0(0)/4] = gfx.de_mem[DE_OVL_BA0(2)/4] = (uintptr_t)(gfx.fb_info.padd + page * gfx.page_size);
 	DE_enableLayer(gfx.de_mem);
-
-	if (gfx.vsync!=VSYNC_OFF) {
-		// this limiting condition helps SuperFX chip games
-		if (gfx.vsync==VSYNC_STRICT || frame_start==0 || SDL_GetTicks()-frame_start<FRAME_BUDGET) { // only wait if we're under frame budget
-			if (ioctl(gfx.fd_fb, OWLFB_WAITFORVSYNC, &_)) LOG_info("OWLFB_WAITFORVSYNC failed %s\n", strerror(errno));
-		}
+}
+static void GFX_waitVsync(void) {
+	if (ioctl(gfx.fd_fb, OWLFB_WAITFORVSYNC, &_)) LOG_info("OWLFB_WAITFORVSYNC failed %s\n", strerror(errno));
+}
+static void GFX_presented(int page, int waited) {
+	if (waited) {
+		gfx.front = page; // the previous front is offscreen now
+		gfx.latching = -1;
 	}
-
-	// swap backbuffer
-	gfx.page ^= 1;
-	gfx.screen->pixels = gfx.fb_info.vadd + gfx.page * PAGE_SIZE;
+	else {
+		// over budget so the DE has latched the last one by now, 
+		// but this one can't be drawn into until the next present
+		if (gfx.latching!=-1) gfx.front = gfx.latching;
+		gfx.latching = page;
+	}
+}
+static void GFX_drainPresent(void) { // afterwards the present thread won't touch the DE until the next GFX_flip()
+	if (!gfx.threaded) return;
+	pthread_mutex_lock(&gfx.present_mx);
+	while (gfx.pending!=-1) pthread_cond_wait(&gfx.present_cv, &gfx.present_mx);
+	pthread_mutex_unlock(&gfx.present_mx);
+}
+static void* GFX_presentThread(void* arg) {
+	// launch.sh leaves cpu1 offline by default, use it if someone brought it up
+	if (getInt("/sys/devices/system/cpu/cpu1/online")) {
+		unsigned long mask = 1 << 1;
+		if (syscall(SYS_sched_setaffinity, 0, sizeof(mask), &mask)) LOG_info("present thread affinity failed %s\n", strerror(errno));
+	}
+	
+	pthread_mutex_lock(&gfx.present_mx);
+	while (1) {
+		while (gfx.pending==-1 && !gfx.present_quit) pthread_cond_wait(&gfx.present_cv, &gfx.present_mx);
+		if (gfx.pending==-1) break; // quitting and nothing left to show
+		
+		int page = gfx.pending;
+		int wait = gfx.present_wait;
+		pthread_mutex_unlock(&gfx.present_mx);
+		
+		GFX_present(page);
+		if (wait) GFX_waitVsync();
+		
+		pthread_mutex_lock(&gfx.present_mx);
+		GFX_presented(page, wait);
+		gfx.pending = -1;
+		pthread_cond_broadcast(&gfx.present_cv);
+	}
+	pthread_mutex_unlock(&gfx.present_mx);
+	return NULL;
+}
+void GFX_setThreaded(int enabled) {
+	if (enabled==gfx.threaded) return;
 	
-	if (gfx.cleared) {
+	if (enabled) {
+		gfx.present_quit = 0;
+		if (pthread_create(&gfx.present_pt, NULL, &GFX_presentThread, NULL)) {
+			LOG_info("present thread failed %s\n", strerror(errno));
+			return;
+		}
+		gfx.threaded = 1;
+	}
+	else {
+		pthread_mutex_lock(&gfx.present_mx);
+		gfx.present_quit = 1; // after showing anything pending
+		pthread_cond_broadcast(&gfx.present_cv);
+		pthread_mutex_unlock(&gfx.present_mx);
+		pthread_join(gfx.present_pt, NULL);
+		gfx.threaded = 0;
+		GFX_waitPage(); // for any deferred clear
+	}
+}
+static void GFX_claimPage(void) {
+	if (gfx.cleared & (1 << gfx.page)) {
 		GFX_clear(gfx.screen);
-		gfx.cleared = 0;
+		gfx.cleared &= ~(1 << gfx.page);
+	}
+}
+static int GFX_isBusy(int page) {
+	return page==gfx.front || page==gfx.pending || page==gfx.latching;
+}
+static int GFX_nextPage(void) {
+	// oldest page that's neither on screen nor about to be
+	for (int i=1; i<PAGE_COUNT; i++) {
+		int page = (gfx.page + i) % PAGE_COUNT;
+		if (!GFX_isBusy(page)) return page;
+	}
+	return (gfx.page + 1) % PAGE_COUNT; // when threaded GFX_waitPage() waits it out
+}
+void GFX_waitPage(void) {
+	if (gfx.threaded) { // with 3+ pages this rarely blocks
+		pthread_mutex_lock(&gfx.present_mx);
+		while (GFX_isBusy(gfx.page)) {
+			int page = GFX_nextPage();
+			if (!GFX_isBusy(page)) { // freed since GFX_flip() picked
+				gfx.page = page;
+				gfx.screen->pixels = gfx.fb_info.vadd + gfx.page * gfx.page_size;
+				break;
+			}
+			if (gfx.pending==-1) { // only a lenient present is in the way and nothing else will move it
+				pthread_mutex_unlock(&gfx.present_mx);
+				GFX_waitVsync();
+				pthread_mutex_lock(&gfx.present_mx);
+				GFX_presented(gfx.latching, 1);
+			}
+			else pthread_cond_wait(&gfx.present_cv, &gfx.present_mx);
+		}
+		pthread_mutex_unlock(&gfx.present_mx);
 	}
+	GFX_claimPage();
+}
+void GFX_flip(SDL_Surface* screen) {
+	// this limiting condition helps SuperFX chip games
+	int wait = gfx.vsync!=VSYNC_OFF && (gfx.vsync==VSYNC_STRICT || frame_start==0 || SDL_GetTicks()-frame_start<FRAME_BUDGET); // only wait if we're under frame budget
+	
+	gfx.last = gfx.page;
+	if (gfx.threaded) {
+		// hand the page off and get back to the core, 
+		// GFX_waitPage() blocks before the next draw if it must
+		pthread_mutex_lock(&gfx.present_mx);
+		while (gfx.pending!=-1) pthread_cond_wait(&gfx.present_cv, &gfx.present_mx); // one in flight
+		gfx.pending = gfx.page;
+		gfx.present_wait = wait;
+		gfx.page = GFX_nextPage();
+		pthread_cond_broadcast(&gfx.present_cv);
+		pthread_mutex_unlock(&gfx.present_mx);
+	}
+	else {
+		GFX_present(gfx.page);
+		if (wait) GFX_waitVsync();
+		GFX_presented(gfx.page, wait);
+		gfx.page = GFX_nextPage();
+	}
+
+	// swap backbuffer
+	gfx.screen->pixels = gfx.fb_info.vadd + gfx.page * gfx.page_size;
+	if (!gfx.threaded) GFX_claimPage(); // otherwise GFX_waitPage() will once it's offscreen
 }
 void GFX_sync(void) {
 	if (gfx.vsync!=VSYNC_OFF) {
@@ -550,30 +815,473 @@ void GFX_sync(void) {
 		if (frame_duration<FRAME_BUDGET) SDL_Delay(FRAME_BUDGET-frame_duration);
 	}
 }
+void GFX_idle(void) {
+	// sleep until there's input or POW_update() has something to do
+	int timeout = -1; // forever
+	if (pow.update_at) {
+		timeout = (int32_t)(pow.update_at - SDL_GetTicks());
+		if (timeout<FRAME_BUDGET) {
+			GFX_sync();
+			return;
+		}
+	}
+	if (!PAD_wait(timeout)) GFX_sync();
+}
 
 SDL_Surface* GFX_getBufferCopy(void) { // must be freed by caller
-	int buffer = gfx.page - 1;
-	if (buffer<0) buffer += PAGE_COUNT;
-	SDL_Surface* copy = SDL_CreateRGBSurface(SDL_SWSURFACE, gfx.screen->w,gfx.screen->h,FIXED_DEPTH,0,0,0,0);
-	SDL_BlitSurface(gfx.screen, NULL, copy, NULL); // TODO: this is just copying screen! :facepalm:
+	GFX_waitPage();
+	SDL_Surface* page = SDL_CreateRGBSurfaceFrom(gfx.fb_info.vadd + gfx.last*gfx.page_size, gfx.width,gfx.height,FIXED_DEPTH,gfx.pitch, RGBA_MASK_AUTO);
+	SDL_Surface* copy = SDL_CreateRGBSurface(SDL_SWSURFACE, page->w,page->h,FIXED_DEPTH,0,0,0,0);
+	SDL_BlitSurface(page, NULL, copy, NULL);
+	SDL_FreeSurface(page);
 	return copy;
 }
-int GFX_truncateText(TTF_Font* font, const char* in_name, char* out_name, int max_width, int padding) {
+
+///////////////////////////////
+
+// the four GFX_Fonts sizes baked into an mmap-able file on first run so text
+// doesn't need FreeType, anything outside Latin-1 still goes through SDL_ttf
+
+#define ATLAS_MAGIC 0x534c5441 // ATLS
+#define ATLAS_VERSION 2
+#define ATLAS_FONT_COUNT 4
+#define ATLAS_FIRST 0x20
+#define ATLAS_LAST 0xff
+#define ATLAS_GLYPH_COUNT (ATLAS_LAST - ATLAS_FIRST + 1)
+#define KERNING_LAST 0x7e // only printable ASCII pairs are baked, the rest stay 0
+
+typedef struct AtlasHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t scale;
+	uint32_t font_size; // of FONT_PATH, to notice a new font
+	int64_t font_mtime;
+	uint32_t pixels_size;
+} AtlasHeader;
+typedef struct AtlasGlyph {
+	uint32_t offset; // into pixels, one alpha byte per pixel
+	int16_t x; // from pen position, negative for overhanging glyphs
+	int16_t advance;
+	uint16_t w; // 0 if SDL_ttf rendered nothing
+	uint16_t h;
+	int16_t minx; // from TTF_GlyphMetrics(), for the extents
+	int16_t maxx;
+} AtlasGlyph;
+typedef struct AtlasFont {
+	int32_t point_size;
+	int32_t height;
+	AtlasGlyph glyphs[ATLAS_GLYPH_COUNT];
+	int8_t kerning[ATLAS_GLYPH_COUNT][ATLAS_GLYPH_COUNT]; // [prev][next], added to the pen before next
+} AtlasFont;
+
+static struct GFX_Atlas {
+	void* data; // mmap'd file
+	size_t size;
+	AtlasFont* fonts;
+	uint8_t* pixels;
+} atlas;
+
+static int GFX_decodeUTF8(const char* str, uint32_t* c) { // returns bytes consumed
+	const uint8_t* s = (const uint8_t*)str;
+	int len;
+	if (s[0]<0x80) { *c = s[0]; return 1; }
+	else if ((s[0]&0xe0)==0xc0) { *c = s[0]&0x1f; len = 2; }
+	else if ((s[0]&0xf0)==0xe0) { *c = s[0]&0x0f; len = 3; }
+	else if ((s[0]&0xf8)==0xf0) { *c = s[0]&0x07; len = 4; }
+	else { *c = 0xfffd; return 1; } // stray continuation byte
+	
+	for (int i=1; i<len; i++) {
+		if ((s[i]&0xc0)!=0x80) { *c = 0xfffd; return i; } // truncated sequence
+		*c = (*c << 6) | (s[i]&0x3f);
+	}
+	return len;
+}
+static int GFX_mapAtlas(struct stat* font_stat) {
+	int fd = open(FONT_ATLAS_PATH, O_RDONLY);
+	if (fd<0) return 0;
+	
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size<sizeof(AtlasHeader)+sizeof(AtlasFont)*ATLAS_FONT_COUNT) {
+		close(fd);
+		return 0;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data==MAP_FAILED) return 0;
+	
+	AtlasHeader* header = data;
+	AtlasFont* fonts = (AtlasFont*)(header + 1);
+	uint8_t* pixels = (uint8_t*)(fonts + ATLAS_FONT_COUNT);
+	size_t size = (uint8_t*)pixels - (uint8_t*)data;
+	
+	int valid = header->magic==ATLAS_MAGIC
+		&& header->version==ATLAS_VERSION
+		&& header->scale==SCREEN_SCALE
+		&& header->font_size==font_stat->st_size
+		&& header->font_mtime==font_stat->st_mtime
+		&& size+header->pixels_size==st.st_size;
+	
+	for (int i=0; valid && i<ATLAS_FONT_COUNT; i++) {
+		AtlasFont* font = &fonts[i];
+		if (font->point_size!=gfx_fonts[i].size) valid = 0;
+		for (int j=0; valid && j<ATLAS_GLYPH_COUNT; j++) {
+			AtlasGlyph* glyph = &font->glyphs[j];
+			if (glyph->offset+glyph->w*glyph->h>header->pixels_size) valid = 0;
+		}
+	}
+	
+	if (!valid) {
+		munmap(data, st.st_size);
+		return 0;
+	}
+	
+	atlas.data = data;
+	atlas.size = st.st_size;
+	atlas.fonts = fonts;
+	atlas.pixels = pixels;
+	return 1;
+}
+
+// pen positions and the extents TTF_SizeUTF8() would find, -1 if str leaves the atlas or its kerning
+static int GFX_layoutText(AtlasFont* font, const char* str, int len, AtlasGlyph** glyphs, int* pens, int* count, int* left) {
+	int n = 0;
+	int pen = 0;
+	int minx = 0;
+	int maxx = 0;
+	int prev = -1;
+	for (int i=0; i<len; ) {
+		uint32_t c;
+		i += GFX_decodeUTF8(&str[i], &c);
+		if (c<ATLAS_FIRST || c>ATLAS_LAST) return -1;
+		if (glyphs && n==MAX_PATH) return -1;
+		
+		int j = c - ATLAS_FIRST;
+		AtlasGlyph* glyph = &font->glyphs[j];
+		if (prev>=0) {
+			if (c>KERNING_LAST || prev>KERNING_LAST-ATLAS_FIRST) return -1; // unbaked pair, SDL_ttf knows its kerning
+			pen += font->kerning[prev][j];
+		}
+		if (pen+glyph->minx<minx) minx = pen + glyph->minx;
+		int right = pen + (glyph->advance>glyph->maxx ? glyph->advance : glyph->maxx);
+		if (right>maxx) maxx = right;
+		
+		if (glyphs) {
+			glyphs[n] = glyph;
+			pens[n] = pen;
+		}
+		n += 1;
+		pen += glyph->advance;
+		prev = j;
+	}
+	if (count) *count = n;
+	if (left) *left = minx;
+	return maxx - minx;
+}
+static void GFX_bakeKerning(TTF_Font* ttf, AtlasFont* font) {
+	// SDL_ttf 2.0 doesn't expose kerning so recover it from the width of each pair,
+	// limited to ASCII since that's what rom names are and every pair costs a TTF_SizeUTF8()
+	char str[3];
+	for (int a=ATLAS_FIRST; a<=KERNING_LAST; a++) {
+		str[0] = a;
+		for (int b=ATLAS_FIRST; b<=KERNING_LAST; b++) {
+			str[1] = b;
+			str[2] = '\0';
+			
+			int w;
+			if (TTF_SizeUTF8(ttf, str, &w, NULL)) continue;
+			int8_t* kerning = &font->kerning[a-ATLAS_FIRST][b-ATLAS_FIRST];
+			*kerning = 0;
+			int k = w - GFX_layoutText(font, str, 2, NULL,NULL,NULL,NULL);
+			if (!k || k<INT8_MIN || k>INT8_MAX) continue;
+			*kerning = k;
+			// only trust it if it accounts for the whole difference
+			if (GFX_layoutText(font, str, 2, NULL,NULL,NULL,NULL)!=w) *kerning = 0;
+		}
+	}
+}
+static void GFX_bakeAtlas(struct stat* font_stat) {
+	AtlasHeader header = {
+		.magic = ATLAS_MAGIC,
+		.version = ATLAS_VERSION,
+		.scale = SCREEN_SCALE,
+		.font_size = font_stat->st_size,
+		.font_mtime = font_stat->st_mtime,
+	};
+	AtlasFont* fonts = calloc(ATLAS_FONT_COUNT, sizeof(AtlasFont));
+	uint32_t capacity = 256 * 1024;
+	uint8_t* pixels = malloc(capacity);
+	
+	for (int i=0; i<ATLAS_FONT_COUNT; i++) {
+		TTF_Font* ttf = GFX_openFont(&gfx_fonts[i]);
+		AtlasFont* font = &fonts[i];
+		font->point_size = gfx_fonts[i].size;
+		font->height = TTF_FontHeight(ttf);
+		
+		for (int c=ATLAS_FIRST; c<=ATLAS_LAST; c++) {
+			AtlasGlyph* glyph = &font->glyphs[c-ATLAS_FIRST];
+			int minx = 0;
+			int maxx = 0;
+			int advance = 0;
+			TTF_GlyphMetrics(ttf, c, &minx,&maxx,NULL,NULL, &advance);
+			glyph->x = minx<0 ? minx : 0; // matches TTF_SizeUTF8()
+			glyph->advance = advance;
+			glyph->minx = minx;
+			glyph->maxx = maxx;
+			
+			char str[3];
+			if (c<0x80) {
+				str[0] = c;
+				str[1] = '\0';
+			}
+			else {
+				str[0] = 0xc0 | (c >> 6);
+				str[1] = 0x80 | (c & 0x3f);
+				str[2] = '\0';
+			}
+			SDL_Surface* text = TTF_RenderUTF8_Blended(ttf, str, COLOR_WHITE);
+			if (!text) continue;
+			
+			int bytes = text->w * text->h;
+			while (header.pixels_size+bytes>capacity) {
+				capacity *= 2;
+				pixels = realloc(pixels, capacity);
+			}
+			glyph->offset = header.pixels_size;
+			glyph->w = text->w;
+			glyph->h = text->h;
+			
+			SDL_PixelFormat* format = text->format;
+			uint8_t* dst = pixels + glyph->offset;
+			for (int y=0; y<text->h; y++) {
+				uint32_t* src = (uint32_t*)((uint8_t*)text->pixels + y * text->pitch);
+				for (int x=0; x<text->w; x++) {
+					*dst++ = (src[x] & format->Amask) >> format->Ashift;
+				}
+			}
+			header.pixels_size += bytes;
+			SDL_FreeSurface(text);
+		}
+		
+		GFX_bakeKerning(ttf, font);
+	}
+	
+	mkdir(USERDATA_PATH "/.minui", 0755);
+	char tmp_path[MAX_PATH];
+	sprintf(tmp_path, "%s.tmp", FONT_ATLAS_PATH);
+	FILE* file = fopen(tmp_path, "wb");
+	if (file) {
+		int ok = fwrite(&header, sizeof(AtlasHeader), 1, file)==1
+			&& fwrite(fonts, sizeof(AtlasFont), ATLAS_FONT_COUNT, file)==ATLAS_FONT_COUNT
+			&& fwrite(pixels, 1, header.pixels_size, file)==header.pixels_size;
+		if (fclose(file)) ok = 0;
+		if (ok) rename(tmp_path, FONT_ATLAS_PATH);
+		else unlink(tmp_path);
+	}
+	
+	free(fonts);
+	free(pixels);
+}
+static void GFX_initAtlas(void) {
+	struct stat font_stat;
+	if (stat(FONT_PATH, &font_stat)) return;
+	if (GFX_mapAtlas(&font_stat)) return;
+	
+	for (int i=0; i<ATLAS_FONT_COUNT; i++) {
+		if (!GFX_openFont(&gfx_fonts[i])) return;
+	}
+	
+	// only happens after installing or changing the font but still takes a moment,
+	// page 1 is already on screen so this shows without a flip
+	LOG_info("baking font atlas\n");
+	SDL_Surface* text = TTF_RenderUTF8_Blended(gfx_fonts[0].ttf, "Preparing fonts...", COLOR_WHITE);
+	if (text) {
+		SDL_BlitSurface(text, NULL, gfx.screen, &(SDL_Rect){(gfx.width-text->w)/2,(gfx.height-text->h)/2});
+		SDL_FreeSurface(text);
+	}
+	
+	GFX_bakeAtlas(&font_stat);
+	GFX_mapAtlas(&font_stat);
+	memset(gfx.screen->pixels, 0, gfx.pitch * gfx.height);
+}
+static void GFX_quitAtlas(void) {
+	if (atlas.data) munmap(atlas.data, atlas.size);
+	memset(&atlas, 0, sizeof(atlas));
+}
+static AtlasFont* GFX_getAtlasFont(GFX_Font* font) {
+	if (!atlas.data) return NULL;
+	return &atlas.fonts[font - gfx_fonts];
+}
+
+SDL_Surface* GFX_renderText(GFX_Font* font, const char* str, SDL_Color color) {
+	AtlasFont* baked = GFX_getAtlasFont(font);
+	
+	// anything the atlas doesn't have goes to SDL_ttf
+	AtlasGlyph* glyphs[MAX_PATH];
+	int pens[MAX_PATH];
+	int count = 0;
+	int left = 0;
+	int width = baked ? GFX_layoutText(baked, str, strlen(str), glyphs, pens, &count, &left) : -1;
+	if (width<0) return TTF_RenderUTF8_Blended(GFX_openFont(font), str, color);
+	if (width==0) return NULL; // same as SDL_ttf
+	
+	SDL_Surface* text = SDL_CreateRGBSurface(SDL_SWSURFACE, width, baked->height, 32, 0x00ff0000,0x0000ff00,0x000000ff,0xff000000);
+	if (!text) return NULL;
+	memset(text->pixels, 0, text->pitch * text->h);
+	
+	uint32_t rgb = (color.r << 16) | (color.g << 8) | color.b;
+	for (int i=0; i<count; i++) {
+		AtlasGlyph* glyph = glyphs[i];
+		int ox = pens[i] - left + glyph->x;
+		int x0 = ox<0 ? -ox : 0; // kerning can push a cell past either edge
+		int x1 = ox+glyph->w>width ? width-ox : glyph->w;
+		int h = glyph->h<text->h ? glyph->h : text->h;
+		for (int y=0; y<h; y++) {
+			uint8_t* src = atlas.pixels + glyph->offset + y * glyph->w;
+			uint32_t* dst = (uint32_t*)((uint8_t*)text->pixels + y * text->pitch) + ox;
+			for (int x=x0; x<x1; x++) {
+				uint32_t a = src[x];
+				if (!a) continue;
+				uint32_t da = dst[x] >> 24;
+				a = da + (a * (255 - da) + 127) / 255; // coverage over coverage, overlaps don't lose or saturate
+				dst[x] = (a << 24) | rgb;
+			}
+		}
+	}
+	
+	return text;
+}
+int GFX_getTextWidth(GFX_Font* font, const char* str) {
+	AtlasFont* baked = GFX_getAtlasFont(font);
+	int w = baked ? GFX_layoutText(baked, str, strlen(str), NULL,NULL,NULL,NULL) : -1;
+	if (w<0 && TTF_SizeUTF8(GFX_openFont(font), str, &w, NULL)) w = 0;
+	return w;
+}
+
+///////////////////////////////
+
+// per-font advance widths so truncating and wrapping don't re-measure whole strings
+// Latin-1 comes from the font atlas, other pages of the BMP are measured on first use
+
+#define GLYPH_FONT_COUNT 4
+#define GLYPH_PAGE_COUNT 256
+#define GLYPH_PAGE_SIZE 256
+
+static struct GlyphTable {
+	GFX_Font* font;
+	int16_t* pages[GLYPH_PAGE_COUNT]; // -1 if not measured yet
+} glyph_tables[GLYPH_FONT_COUNT];
+
+static int16_t* GFX_getGlyphPage(struct GlyphTable* table, int page) {
+	if (!table->pages[page]) {
+		table->pages[page] = malloc(sizeof(int16_t) * GLYPH_PAGE_SIZE);
+		memset(table->pages[page], 0xff, sizeof(int16_t) * GLYPH_PAGE_SIZE);
+	}
+	return table->pages[page];
+}
+static int GFX_getGlyphAdvance(struct GlyphTable* table, uint32_t c) {
+	if (c>0xffff) c = 0xfffd; // SDL_ttf only handles UCS-2
+	int16_t* advances = GFX_getGlyphPage(table, c / GLYPH_PAGE_SIZE);
+	int16_t* advance = &advances[c % GLYPH_PAGE_SIZE];
+	if (*advance<0) {
+		int w;
+		if (TTF_GlyphMetrics(GFX_openFont(table->font), c, NULL,NULL,NULL,NULL, &w)) w = 0;
+		*advance = w;
+	}
+	return *advance;
+}
+static void GFX_initGlyphs(int i, GFX_Font* font) {
+	struct GlyphTable* table = &glyph_tables[i];
+	table->font = font;
+	AtlasFont* baked = GFX_getAtlasFont(font);
+	if (!baked) return;
+	int16_t* advances = GFX_getGlyphPage(table, 0);
+	for (int c=ATLAS_FIRST; c<=ATLAS_LAST; c++) {
+		advances[c] = baked->glyphs[c-ATLAS_FIRST].advance;
+	}
+}
+static void GFX_quitGlyphs(void) {
+	for (int i=0; i<GLYPH_FONT_COUNT; i++) {
+		struct GlyphTable* table = &glyph_tables[i];
+		for (int j=0; j<GLYPH_PAGE_COUNT; j++) {
+			free(table->pages[j]);
+			table->pages[j] = NULL;
+		}
+		table->font = NULL;
+	}
+}
+static struct GlyphTable* GFX_getGlyphTable(GFX_Font* font) {
+	for (int i=0; i<GLYPH_FONT_COUNT; i++) {
+		if (glyph_tables[i].font==font) return &glyph_tables[i];
+	}
+	return NULL;
+}
+
+static int GFX_getKerning(AtlasFont* baked, uint32_t prev, uint32_t c) {
+	if (!baked || prev<ATLAS_FIRST || prev>ATLAS_LAST || c<ATLAS_FIRST || c>ATLAS_LAST) return 0;
+	return baked->kerning[prev-ATLAS_FIRST][c-ATLAS_FIRST];
+}
+static int GFX_measureText(GFX_Font* font, const char* str, int len) { // advances and kerning, ignores overhang
+	struct GlyphTable* table = GFX_getGlyphTable(font);
+	AtlasFont* baked = GFX_getAtlasFont(font);
+	int w = 0;
+	uint32_t prev = 0;
+	for (int i=0; i<len; ) {
+		uint32_t c;
+		i += GFX_decodeUTF8(&str[i], &c);
+		w += GFX_getKerning(baked, prev, c) + GFX_getGlyphAdvance(table, c);
+		prev = c;
+	}
+	return w;
+}
+
+int GFX_truncateText(GFX_Font* font, const char* in_name, char* out_name, int max_width, int padding) {
 	int text_width;
 	strcpy(out_name, in_name);
-	TTF_SizeUTF8(font, out_name, &text_width, NULL);
+	text_width = GFX_getTextWidth(font, out_name);
 	text_width += padding;
+	if (text_width<=max_width) return text_width;
+	
+	// width of every prefix that ends on a character boundary
+	int len = strlen(in_name);
+	int ends[len+1];
+	int widths[len+1];
+	int count = 1;
+	ends[0] = 0;
+	widths[0] = 0;
+	struct GlyphTable* table = GFX_getGlyphTable(font);
+	AtlasFont* baked = GFX_getAtlasFont(font);
+	uint32_t prev = 0;
+	for (int i=0; i<len; count++) {
+		uint32_t c;
+		i += GFX_decodeUTF8(&in_name[i], &c);
+		widths[count] = widths[count-1] + GFX_getKerning(baked, prev, c) + GFX_getGlyphAdvance(table, c);
+		ends[count] = i;
+		prev = c;
+	}
 	
-	while (text_width>max_width) {
-		int len = strlen(out_name);
-		strcpy(&out_name[len-4], "...\0");
-		TTF_SizeUTF8(font, out_name, &text_width, NULL);
+	// longest prefix that fits with the ellipsis
+	int available = max_width - padding - GFX_measureText(font, "...", 3);
+	int lo = 0;
+	int hi = count - 1;
+	while (lo<hi) {
+		int mid = (lo + hi + 1) / 2;
+		if (widths[mid]<=available) lo = mid;
+		else hi = mid - 1;
+	}
+	
+	// advances ignore overhang so confirm and back off if needed
+	while (1) {
+		memcpy(out_name, in_name, ends[lo]);
+		strcpy(&out_name[ends[lo]], "...");
+		text_width = GFX_getTextWidth(font, out_name);
 		text_width += padding;
+		if (text_width<=max_width || lo==0) break;
+		lo -= 1;
 	}
 	
 	return text_width;
 }
-int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines) {
+int GFX_wrapText(GFX_Font* font, char* str, int max_width, int max_lines) {
 	if (!str) return 0;
 	
 	int line_width;
@@ -581,49 +1289,43 @@ int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines) {
 	char* line = str;
 	char buffer[MAX_PATH];
 	
-	TTF_SizeUTF8(font, line, &line_width, NULL);
+	line_width = GFX_getTextWidth(font, line);
 	if (line_width<=max_width) {
 		line_width = GFX_truncateText(font,line,buffer,max_width,0);
 		strcpy(line,buffer);
 		return line_width;
 	}
 	
-	char* prev = NULL;
+	int space_width = GFX_measureText(font, " ", 1);
+	char* prev = NULL; // last space on the current line
 	char* tmp = line;
 	int lines = 1;
-	int i = 0;
+	line_width = 0; // up to tmp
 	while (!max_lines || lines<max_lines) {
-		tmp = strchr(tmp, ' ');
-		if (!tmp) {
-			if (prev) {
-				TTF_SizeUTF8(font, line, &line_width, NULL);
-				if (line_width>=max_width) {
-					if (line_width>max_line_width) max_line_width = line_width;
-					prev[0] = '\n';
-					line = prev + 1;
-				}
-			}
-			break;
-		}
-		tmp[0] = '\0';
+		char* next = strchr(tmp, ' ');
+		int word_width = GFX_measureText(font, tmp, next ? next-tmp : strlen(tmp));
 		
-		TTF_SizeUTF8(font, line, &line_width, NULL);
-
-		if (line_width>=max_width) { // wrap
-			if (line_width>max_line_width) max_line_width = line_width;
-			tmp[0] = ' ';
-			tmp += 1;
+		if (prev && line_width+word_width>=max_width) { // wrap
+			int prev_width = line_width - space_width;
+			if (prev_width>max_line_width) max_line_width = prev_width;
 			prev[0] = '\n';
-			prev += 1;
-			line = prev;
+			line = prev + 1;
+			line_width = 0;
 			lines += 1;
+			
+			// measure the word on its new line
+			if (next) {
+				line_width = GFX_measureText(font, line, next-line);
+			}
 		}
-		else { // continue
-			tmp[0] = ' ';
-			prev = tmp;
-			tmp += 1;
+		else {
+			line_width += word_width;
 		}
-		i += 1;
+		
+		if (!next) break;
+		prev = next;
+		line_width += space_width;
+		tmp = next + 1;
 	}
 	
 	line_width = GFX_truncateText(font,line,buffer,max_width,0);
@@ -633,6 +1335,91 @@ int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines) {
 	return max_line_width;
 }
 
+///////////////////////////////
+
+// an LRU of rendered text so redrawing the same rows is mostly blits
+
+#define TEXT_CACHE_SLOTS 64
+#define TEXT_CACHE_BYTES (4 * 1024 * 1024) // large font rows are ~100KB each
+
+static struct TextCache {
+	struct TextCacheSlot {
+		uint32_t hash;
+		GFX_Font* font;
+		uint32_t color;
+		char* str;
+		SDL_Surface* surface; // NULL if empty
+		uint32_t used; // tick of last use
+	} slots[TEXT_CACHE_SLOTS];
+	uint32_t tick;
+	int bytes;
+} text_cache;
+
+static void GFX_evictText(struct TextCacheSlot* slot) {
+	if (!slot->surface) return;
+	text_cache.bytes -= slot->surface->pitch * slot->surface->h;
+	SDL_FreeSurface(slot->surface);
+	free(slot->str);
+	slot->surface = NULL;
+	slot->str = NULL;
+}
+static struct TextCacheSlot* GFX_leastRecentText(int or_empty) {
+	struct TextCacheSlot* lru = NULL;
+	for (int i=0; i<TEXT_CACHE_SLOTS; i++) {
+		struct TextCacheSlot* slot = &text_cache.slots[i];
+		if (!slot->surface) {
+			if (or_empty) return slot;
+			continue;
+		}
+		if (!lru || slot->used<lru->used) lru = slot;
+	}
+	return lru;
+}
+SDL_Surface* GFX_getText(GFX_Font* font, const char* str, SDL_Color color) {
+	uint32_t rgb = (color.r << 16) | (color.g << 8) | color.b;
+	uint32_t hash = 2166136261u; // FNV-1a
+	for (const char* c=str; *c; c++) {
+		hash ^= (uint8_t)*c;
+		hash *= 16777619u;
+	}
+	hash ^= rgb ^ (uint32_t)(uintptr_t)font;
+	
+	text_cache.tick += 1;
+	for (int i=0; i<TEXT_CACHE_SLOTS; i++) {
+		struct TextCacheSlot* slot = &text_cache.slots[i];
+		if (slot->surface && slot->hash==hash && slot->font==font && slot->color==rgb && !strcmp(slot->str, str)) {
+			slot->used = text_cache.tick;
+			return slot->surface;
+		}
+	}
+	
+	SDL_Surface* surface = GFX_renderText(font, str, color);
+	if (!surface) return NULL;
+	int bytes = surface->pitch * surface->h;
+	
+	while (text_cache.bytes+bytes>TEXT_CACHE_BYTES && text_cache.bytes>0) {
+		GFX_evictText(GFX_leastRecentText(0));
+	}
+	struct TextCacheSlot* slot = GFX_leastRecentText(1);
+	GFX_evictText(slot);
+	
+	slot->hash = hash;
+	slot->font = font;
+	slot->color = rgb;
+	slot->str = strdup(str);
+	slot->surface = surface;
+	slot->used = text_cache.tick;
+	text_cache.bytes += bytes;
+	return surface;
+}
+void GFX_clearTextCache(void) {
+	for (int i=0; i<TEXT_CACHE_SLOTS; i++) {
+		GFX_evictText(&text_cache.slots[i]);
+	}
+}
+
+///////////////////////////////
+
 void GFX_blitAsset(int asset, SDL_Rect* src_rect, SDL_Surface* dst, SDL_Rect* dst_rect) {
 	SDL_Rect* rect = &asset_rects[asset];
 	SDL_Rect adj_rect = {
@@ -720,7 +1507,6 @@ void GFX_blitBattery(SDL_Surface* dst, SDL_Rect* dst_rect) {
 }
 int GFX_getButtonWidth(char* hint, char* button) {
 	int button_width = 0;
-	int width;
 	
 	int special_case = !strcmp(button,BRIGHTNESS_BUTTON_LABEL); // TODO: oof
 	
@@ -729,13 +1515,11 @@ int GFX_getButtonWidth(char* hint, char* button) {
 	}
 	else {
 		button_width += SCALE1(BUTTON_SIZE) / 2;
-		TTF_SizeUTF8(special_case ? font.large : font.tiny, button, &width, NULL);
-		button_width += width;
+		button_width += GFX_getTextWidth(special_case ? font.large : font.tiny, button);
 	}
 	button_width += SCALE1(BUTTON_MARGIN);
 	
-	TTF_SizeUTF8(font.small, hint, &width, NULL);
-	button_width += width + SCALE1(BUTTON_MARGIN);
+	button_width += GFX_getTextWidth(font.small, hint) + SCALE1(BUTTON_MARGIN);
 	return button_width;
 }
 void GFX_blitButton(char* hint, char*button, SDL_Surface* dst, SDL_Rect* dst_rect) {
@@ -749,13 +1533,12 @@ void GFX_blitButton(char* hint, char*button, SDL_Surface* dst, SDL_Rect* dst_rec
 		GFX_blitAsset(ASSET_BUTTON, NULL, dst, dst_rect);
 
 		// label
-		text = TTF_RenderUTF8_Blended(font.medium, button, COLOR_BUTTON_TEXT);
+		text = GFX_getText(font.medium, button, COLOR_BUTTON_TEXT);
 		SDL_BlitSurface(text, NULL, dst, &(SDL_Rect){dst_rect->x+(SCALE1(BUTTON_SIZE)-text->w)/2,dst_rect->y+(SCALE1(BUTTON_SIZE)-text->h)/2});
 		ox += SCALE1(BUTTON_SIZE);
-		SDL_FreeSurface(text);
 	}
 	else {
-		text = TTF_RenderUTF8_Blended(special_case ? font.large : font.tiny, button, COLOR_BUTTON_TEXT);
+		text = GFX_getText(special_case ? font.large : font.tiny, button, COLOR_BUTTON_TEXT);
 		GFX_blitPill(ASSET_BUTTON, dst, &(SDL_Rect){dst_rect->x,dst_rect->y,SCALE1(BUTTON_SIZE)/2+text->w,SCALE1(BUTTON_SIZE)});
 		ox += SCALE1(BUTTON_SIZE)/4;
 		
@@ -763,17 +1546,15 @@ void GFX_blitButton(char* hint, char*button, SDL_Surface* dst, SDL_Rect* dst_rec
 		SDL_BlitSurface(text, NULL, dst, &(SDL_Rect){ox+dst_rect->x,oy+dst_rect->y+(SCALE1(BUTTON_SIZE)-text->h)/2,text->w,text->h});
 		ox += text->w;
 		ox += SCALE1(BUTTON_SIZE)/4;
-		SDL_FreeSurface(text);
 	}
 	
 	ox += SCALE1(BUTTON_MARGIN);
 
 	// hint text
-	text = TTF_RenderUTF8_Blended(font.small, hint, COLOR_WHITE);
+	text = GFX_getText(font.small, hint, COLOR_WHITE);
 	SDL_BlitSurface(text, NULL, dst, &(SDL_Rect){ox+dst_rect->x,dst_rect->y+(SCALE1(BUTTON_SIZE)-text->h)/2,text->w,text->h});
-	SDL_FreeSurface(text);
 }
-void GFX_blitMessage(TTF_Font* font, char* msg, SDL_Surface* dst, SDL_Rect* dst_rect) {
+void GFX_blitMessage(GFX_Font* font, char* msg, SDL_Surface* dst, SDL_Rect* dst_rect) {
 	if (dst_rect==NULL) dst_rect = &(SDL_Rect){0,0,dst->w,dst->h};
 	
 	SDL_Surface* text;
@@ -808,11 +1589,10 @@ void GFX_blitMessage(TTF_Font* font, char* msg, SDL_Surface* dst, SDL_Rect* dst_
 		
 		
 		if (len) {
-			text = TTF_RenderUTF8_Blended(font, line, COLOR_WHITE);
+			text = GFX_getText(font, line, COLOR_WHITE);
 			int x = dst_rect->x;
 			x += (dst_rect->w - text->w) / 2;
 			SDL_BlitSurface(text, NULL, dst, &(SDL_Rect){x,y});
-			SDL_FreeSurface(text);
 		}
 		y += SCALE1(LINE_HEIGHT);
 	}
@@ -938,7 +1718,7 @@ int GFX_blitButtonGroup(char** pairs, SDL_Surface* dst, int align_right) {
 }
 
 #define MAX_TEXT_LINES 16
-void GFX_sizeText(TTF_Font* font, char* str, int leading, int* w, int* h) {
+void GFX_sizeText(GFX_Font* font, char* str, int leading, int* w, int* h) {
 	char* lines[MAX_TEXT_LINES];
 	int count = 0;
 
@@ -965,14 +1745,13 @@ void GFX_sizeText(TTF_Font* font, char* str, int leading, int* w, int* h) {
 		}
 		
 		if (len) {
-			int lw;
-			TTF_SizeUTF8(font, line, &lw, NULL);
+			int lw = GFX_getTextWidth(font, line);
 			if (lw>mw) mw = lw;
 		}
 	}
 	*w = mw;
 }
-void GFX_blitText(TTF_Font* font, char* str, int leading, SDL_Color color, SDL_Surface* dst, SDL_Rect* dst_rect) {
+void GFX_blitText(GFX_Font* font, char* str, int leading, SDL_Color color, SDL_Surface* dst, SDL_Rect* dst_rect) {
 	if (dst_rect==NULL) dst_rect = &(SDL_Rect){0,0,dst->w,dst->h};
 	
 	char* lines[MAX_TEXT_LINES];
@@ -1002,9 +1781,8 @@ void GFX_blitText(TTF_Font* font, char* str, int leading, SDL_Color color, SDL_S
 		}
 		
 		if (len) {
-			text = TTF_RenderUTF8_Blended(font, line, color);
+			text = GFX_getText(font, line, color);
 			SDL_BlitSurface(text, NULL, dst, &(SDL_Rect){x+((dst_rect->w-text->w)/2),y+(i*leading)});
-			SDL_FreeSurface(text);
 		}
 	}
 }
@@ -1018,51 +1796,200 @@ void GFX_blitText(TTF_Font* font, char* str, int leading, SDL_Color color, SDL_S
 
 #define MAX_SAMPLE_RATE 48000
 #define BATCH_SIZE 100
+#define SND_WAIT_SLICE 10 // ms, per futex wait
+#define SND_WAIT_LIMIT 25 // slices before dropping samples (the device stopped pulling)
+#define SND_HISTORY 3 // window frames kept between batches, cubic needs 1 before and 2 after
+#define SND_RATE_CONTROL_DELTA 0.005 // max ratio nudge, RetroArch's default, inaudible
+#define SND_LATENCY_DEFAULT 64 // ms
+#define SND_PERIOD_MIN 128 // frames
+#define SND_FF_SEGMENT 960 // frames played between jumps while fast forwarding, 20ms at 48kHz
+#define SND_FF_OVERLAP 240 // crossfaded at each jump
+#define SND_FF_SEARCH 240 // how far stretch looks ahead for the best join
+#define SND_FF_BUFFER 4096 // a segment, overlap and search plus up to half this again
+#ifndef SND_ALSA_DEVICE
+#define SND_ALSA_DEVICE "default" // eg. -DSND_ALSA_DEVICE=\"null\" to test on a desktop
+#endif
+
+// single producer (emulation thread) single consumer (SDL audio thread) ring,
+// frame_in and frame_out only ever increase and are masked into buffer
 
-typedef int (*SND_Resampler)(const SND_Frame frame);
+// with HAVE_ALSA we try writing straight to the pcm first, its buffer 
+// replaces the ring and there's no audio thread at all, SDL is the fallback
+
+typedef int (*SND_Resampler)(const SND_Frame* frames, int frame_count, SND_Frame* out); // returns frames written to out
 static struct SND_Context {
 	double frame_rate;
 	
 	int sample_rate_in;
 	int sample_rate_out;
 	
-	int buffer_seconds;     // current_audio_buffer_size
+	int latency; // ms, device period plus what's queued in the ring
+	int period; // frames, per SDL callback
+	int frame_target; // frames queued in the ring that rate control aims for
+	
 	SND_Frame* buffer;	// buf
-	size_t frame_count; 	// buf_len
+	size_t frame_count; 	// buf_len, always a power of 2, at least twice frame_target (ALSA: its buffer size)
+	uint32_t frame_mask;
+	int frame_limit; // frames the producer may queue, twice frame_target so latency is bounded by the setting, not the rounding
+	
+	uint32_t frame_in;  // buf_w, only written by the producer
+	uint32_t frame_out; // buf_r, only written by the consumer, also a futex
+	int waiting; // producer is (about to be) waiting on frame_out
 	
-	int frame_in;     // buf_w
-	int frame_out;    // buf_r
-	int frame_filled; // max_buf_w
+	int underruns; // only written by the consumer
+	int overruns; // only written by the producer
+	int starved; // consumer came up short last callback, counts each underrun once
 	
 	SND_Resampler resample;
+	SND_Frame* resampled; // BATCH_SIZE frames after resampling
+	int resampler; // SND_RESAMPLER_*
+	int quality; // sinc only, 0 (lowest) to 4 (highest)
+	double ratio_base; // sample_rate_in / sample_rate_out
+	double ratio; // input frames per output frame, ratio_base after rate control
+	double adjust; // rate control, multiplies the output rate
+	double position; // in window
+	SND_Frame window[SND_HISTORY + BATCH_SIZE];
+#ifdef HAVE_SINC_RESAMPLER
+	void* sinc;
+	float* sinc_in;
+	float* sinc_out;
+#endif
+#ifdef HAVE_ALSA
+	snd_pcm_t* pcm; // NULL when using SDL
+#endif
+#ifdef HAVE_DSP_FILTER
+	char dsp_path[MAX_PATH]; // empty for none
+	retro_dsp_filter_t* dsp;
+	float* dsp_in;
+	int dsp_in_count; // capacity in frames
+	SND_Frame* dsp_out;
+	int dsp_out_count;
+#endif
 } snd;
+
+static void SND_copyIn(uint32_t at, const SND_Frame* frames, int count) { // split at the end of the ring
+	uint32_t i = at & snd.frame_mask;
+	int span = snd.frame_count - i;
+	if (span>count) span = count;
+	memcpy(&snd.buffer[i], frames, span * sizeof(SND_Frame));
+	if (count>span) memcpy(snd.buffer, frames + span, (count - span) * sizeof(SND_Frame));
+}
+static void SND_copyOut(uint32_t at, SND_Frame* frames, int count) {
+	uint32_t i = at & snd.frame_mask;
+	int span = snd.frame_count - i;
+	if (span>count) span = count;
+	memcpy(frames, &snd.buffer[i], span * sizeof(SND_Frame));
+	if (count>span) memcpy(frames + span, snd.buffer, (count - span) * sizeof(SND_Frame));
+}
+
 static void SND_audioCallback(void* userdata, uint8_t* stream, int len) { // plat_sound_callback
 	if (snd.frame_count==0) return;
 	
-	int16_t *out = (int16_t *)stream;
-	len /= (sizeof(int16_t) * 2);
+	SND_Frame* out = (SND_Frame*)stream;
+	int count = len / sizeof(SND_Frame);
 	
-	while (snd.frame_out!=snd.frame_in && len>0) {
-		*out++ = snd.buffer[snd.frame_out].left;
-		*out++ = snd.buffer[snd.frame_out].right;
-		
-		snd.frame_filled = snd.frame_out;
-		
-		snd.frame_out += 1;
-		len -= 1;
+	uint32_t frame_out = snd.frame_out;
+	uint32_t available = __atomic_load_n(&snd.frame_in, __ATOMIC_ACQUIRE) - frame_out;
+	int amount = available<count ? available : count;
+	
+	SND_copyOut(frame_out, out, amount);
+	__atomic_store_n(&snd.frame_out, frame_out + amount, __ATOMIC_SEQ_CST);
+	if (amount && __atomic_load_n(&snd.waiting, __ATOMIC_SEQ_CST)) {
+		syscall(SYS_futex, &snd.frame_out, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+	
+	if (amount<count) {
+		memset(out + amount, 0, (count - amount) * sizeof(SND_Frame)); // underrun
+		if (!snd.starved) snd.underruns += 1;
+	}
+	snd.starved = amount<count;
+}
+static int SND_waitForSpace(uint32_t frame_out) { // returns 0 if the consumer didn't move
+	__atomic_store_n(&snd.waiting, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&snd.frame_out, __ATOMIC_SEQ_CST)==frame_out) {
+		struct timespec timeout = { 0, SND_WAIT_SLICE * 1000000 };
+		syscall(SYS_futex, &snd.frame_out, FUTEX_WAIT_PRIVATE, frame_out, &timeout, NULL, 0);
+	}
+	__atomic_store_n(&snd.waiting, 0, __ATOMIC_SEQ_CST);
+	return __atomic_load_n(&snd.frame_out, __ATOMIC_ACQUIRE)!=frame_out;
+}
+#ifdef HAVE_ALSA
+static void SND_writeALSA(const SND_Frame* frames, int count) { // same wait and drop rules as the ring
+	int waits = 0;
+	int full = 0;
+	while (count>0) {
+		snd_pcm_sframes_t written = snd_pcm_writei(snd.pcm, frames, count);
+		if (written==-EAGAIN) {
+			if (!full++) snd.overruns += 1;
+			if (snd_pcm_wait(snd.pcm, SND_WAIT_SLICE)) waits = 0; // errors are handled by the next write
+			else if (++waits>=SND_WAIT_LIMIT) return;
+			continue;
+		}
+		if (written<0) {
+			if (written==-EPIPE) snd.underruns += 1; // eg. after sitting in the menu
+			if (snd_pcm_recover(snd.pcm, written, 1)<0) return;
+			continue;
+		}
 		
-		if (snd.frame_out>=snd.frame_count) snd.frame_out = 0;
+		frames += written;
+		count -= written;
 	}
+}
+#endif
+static void SND_write(const SND_Frame* frames, int count) {
+#ifdef HAVE_ALSA
+	if (snd.pcm) {
+		SND_writeALSA(frames, count);
+		return;
+	}
+#endif
 	
-	while (len>0) {
-		*out++ = 0;
-		*out++ = 0;
-		len -= 1;
+	int waits = 0;
+	int full = 0;
+	while (count>0) {
+		uint32_t frame_in = snd.frame_in;
+		uint32_t frame_out = __atomic_load_n(&snd.frame_out, __ATOMIC_ACQUIRE);
+		int space = snd.frame_limit - (int)(frame_in - frame_out);
+		if (space<=0) {
+			if (!full++) snd.overruns += 1;
+			if (SND_waitForSpace(frame_out)) waits = 0;
+			else if (++waits>=SND_WAIT_LIMIT) return;
+			continue;
+		}
+		
+		int amount = space<count ? space : count;
+		SND_copyIn(frame_in, frames, amount);
+		__atomic_store_n(&snd.frame_in, frame_in + amount, __ATOMIC_RELEASE);
+		
+		frames += amount;
+		count -= amount;
 	}
 }
+
+static int SND_getPeriod(int sample_rate) {
+	// largest power of 2 within a quarter of the latency, leaves the rest to the ring
+	int limit = sample_rate * snd.latency / 1000 / 4;
+	int period = SND_PERIOD_MIN;
+	while (period * 2<=limit) period <<= 1;
+	return period;
+}
+static void SND_updateTarget(void) {
+	// the device holds one period, the ring is sized so rate control 
+	// can keep the rest of the latency queued at half full
+	snd.frame_target = snd.sample_rate_out * snd.latency / 1000 - snd.period;
+	if (snd.frame_target<snd.period) snd.frame_target = snd.period;
+}
 static void SND_resizeBuffer(void) { // plat_sound_resize_buffer
-	snd.frame_count = snd.buffer_seconds * snd.sample_rate_in / snd.frame_rate;
-	if (snd.frame_count==0) return;
+	SND_updateTarget();
+	
+	size_t frame_count = snd.frame_target * 2;
+	snd.frame_count = 0;
+	if (frame_count==0) return;
+	
+	snd.frame_count = 1;
+	while (snd.frame_count<frame_count) snd.frame_count <<= 1;
+	snd.frame_mask = snd.frame_count - 1;
+	snd.frame_limit = frame_count;
 	
 	SDL_LockAudio();
 	
@@ -1073,119 +2000,515 @@ static void SND_resizeBuffer(void) { // plat_sound_resize_buffer
 	
 	snd.frame_in = 0;
 	snd.frame_out = 0;
-	snd.frame_filled = snd.frame_count - 1;
 	
 	SDL_UnlockAudio();
 }
-static int SND_resampleNone(SND_Frame frame) { // audio_resample_passthrough
-	snd.buffer[snd.frame_in++] = frame;
-	if (snd.frame_in >= snd.frame_count) snd.frame_in = 0;
-	return 1;
-}
-static int SND_resampleNear(SND_Frame frame) { // audio_resample_nearest
-	static int diff = 0;
-	int consumed = 0;
+// resamplers work on whole batches, the interpolating ones keep the tail of the
+// previous batch in window so there are no seams between batches
 
-	if (diff < snd.sample_rate_out) {
-		snd.buffer[snd.frame_in++] = frame;
-		if (snd.frame_in >= snd.frame_count) snd.frame_in = 0;
-		diff += snd.sample_rate_in;
+static inline int16_t SND_clamp(float sample) {
+	if (sample>32767.0f) return 32767;
+	if (sample<-32768.0f) return -32768;
+	return (int16_t)sample;
+}
+static int SND_resampleWindow(const SND_Frame* frames, int frame_count, SND_Frame* out) { // nearest, linear and cubic
+	SND_Frame* w = snd.window;
+	memcpy(w + SND_HISTORY, frames, frame_count * sizeof(SND_Frame));
+	
+	int count = 0;
+	double position = snd.position;
+	double end = frame_count + 1; // keeps i+2 inside the window
+	switch (snd.resampler) {
+		case SND_RESAMPLER_NEAREST:
+			while (position<end) {
+				int i = position + 0.5;
+				out[count++] = w[i];
+				position += snd.ratio;
+			}
+			break;
+		case SND_RESAMPLER_LINEAR:
+			while (position<end) {
+				int i = position;
+				float t = position - i;
+				out[count].left  = SND_clamp(w[i].left  + (w[i+1].left  - w[i].left)  * t);
+				out[count].right = SND_clamp(w[i].right + (w[i+1].right - w[i].right) * t);
+				count += 1;
+				position += snd.ratio;
+			}
+			break;
+		case SND_RESAMPLER_CUBIC: // catmull-rom
+			while (position<end) {
+				int i = position;
+				float t = position - i;
+				#define CUBIC(a,b,c,d) ((b) + 0.5f * t * ((c) - (a) + t * (2.0f*(a) - 5.0f*(b) + 4.0f*(c) - (d) + t * (3.0f*((b) - (c)) + (d) - (a)))))
+				out[count].left  = SND_clamp(CUBIC(w[i-1].left,  w[i].left,  w[i+1].left,  w[i+2].left));
+				out[count].right = SND_clamp(CUBIC(w[i-1].right, w[i].right, w[i+1].right, w[i+2].right));
+				#undef CUBIC
+				count += 1;
+				position += snd.ratio;
+			}
+			break;
 	}
-
-	if (diff >= snd.sample_rate_out) {
-		consumed++;
-		diff -= snd.sample_rate_out;
+	
+	snd.position = position - frame_count;
+	memmove(w, w + frame_count, SND_HISTORY * sizeof(SND_Frame));
+	return count;
+}
+#ifdef HAVE_SINC_RESAMPLER
+static int SND_resampleSinc(const SND_Frame* frames, int frame_count, SND_Frame* out) {
+	float* in = snd.sinc_in;
+	for (int i=0; i<frame_count; i++) {
+		*in++ = frames[i].left  * (1.0f / 32768.0f);
+		*in++ = frames[i].right * (1.0f / 32768.0f);
 	}
-
-	return consumed;
+	
+	struct resampler_data data = {
+		.data_in = snd.sinc_in,
+		.data_out = snd.sinc_out,
+		.input_frames = frame_count,
+		.ratio = 1.0 / snd.ratio, // libretro's is out/in
+	};
+	sinc_resampler.process(snd.sinc, &data);
+	
+	float* samples = snd.sinc_out;
+	for (int i=0; i<data.output_frames; i++) {
+		out[i].left  = SND_clamp(*samples++ * 32768.0f);
+		out[i].right = SND_clamp(*samples++ * 32768.0f);
+	}
+	return data.output_frames;
+}
+static void SND_freeSinc(void) {
+	if (snd.sinc) sinc_resampler.free(snd.sinc);
+	free(snd.sinc_in);
+	free(snd.sinc_out);
+	snd.sinc = NULL;
+	snd.sinc_in = NULL;
+	snd.sinc_out = NULL;
 }
+#endif
 static void SND_selectResampler(void) { // plat_sound_select_resampler
-	if (snd.sample_rate_in==snd.sample_rate_out) {
-		snd.resample =  SND_resampleNone;
+#ifdef HAVE_SINC_RESAMPLER
+	SND_freeSinc();
+#endif
+	
+	snd.ratio_base = (double)snd.sample_rate_in / snd.sample_rate_out;
+	snd.ratio = snd.ratio_base;
+	snd.adjust = 1.0;
+	snd.position = 1.0;
+	memset(snd.window, 0, sizeof(snd.window));
+	
+	// no passthrough even when the rates match, rate control needs to
+	// stretch the output a little to follow the video clock
+	
+	// worst case upsampling output for a full batch
+	int frame_count = BATCH_SIZE / (snd.ratio_base * (1.0 - SND_RATE_CONTROL_DELTA)) + 8;
+	snd.resampled = realloc(snd.resampled, frame_count * sizeof(SND_Frame));
+	snd.resample = SND_resampleWindow;
+	
+	if (snd.resampler==SND_RESAMPLER_SINC) {
+#ifdef HAVE_SINC_RESAMPLER
+		struct resampler_config config = {0};
+		enum resampler_quality quality = RESAMPLER_QUALITY_LOWEST + snd.quality;
+		snd.sinc = sinc_resampler.init(&config, 1.0 / snd.ratio, quality, RESAMPLER_SIMD_NEON);
+		if (snd.sinc) {
+			snd.sinc_in = malloc(BATCH_SIZE * 2 * sizeof(float));
+			snd.sinc_out = malloc(frame_count * 2 * sizeof(float));
+			snd.resample = SND_resampleSinc;
+			return;
+		}
+#endif
+		snd.resampler = SND_RESAMPLER_CUBIC; // closest thing we have
 	}
-	else {
-		snd.resample = SND_resampleNear;
+}
+void SND_setResampler(int resampler, int quality) {
+	snd.resampler = resampler;
+	snd.quality = quality;
+	if (snd.sample_rate_out) SND_selectResampler(); // otherwise SND_init() will
+}
+
+// optional filter chain after the resampler, a libretro .dsp 
+// preset (eg. a lowpass for the tiny speaker), float in the middle
+
+#ifdef HAVE_DSP_FILTER
+static void SND_freeFilter(void) {
+	if (snd.dsp) retro_dsp_filter_free(snd.dsp);
+	free(snd.dsp_in);
+	free(snd.dsp_out);
+	snd.dsp = NULL;
+	snd.dsp_in = NULL;
+	snd.dsp_out = NULL;
+	snd.dsp_in_count = 0;
+	snd.dsp_out_count = 0;
+}
+static void SND_selectFilter(void) { // filters are built for a sample rate
+	SND_freeFilter();
+	if (!snd.dsp_path[0]) return;
+	
+	snd.dsp = retro_dsp_filter_new(snd.dsp_path, NULL, snd.sample_rate_out);
+	if (!snd.dsp) LOG_info("couldn't load dsp filter %s\n", snd.dsp_path);
+	else LOG_info("dsp filter: %s\n", snd.dsp_path);
+}
+static int SND_filter(const SND_Frame* frames, int frame_count, SND_Frame** out) { // returns frames in out, not always frame_count (eg. eq works in blocks)
+	if (frame_count>snd.dsp_in_count) {
+		snd.dsp_in_count = frame_count;
+		snd.dsp_in = realloc(snd.dsp_in, frame_count * 2 * sizeof(float));
+	}
+	
+	float* in = snd.dsp_in;
+	for (int i=0; i<frame_count; i++) {
+		*in++ = frames[i].left  * (1.0f / 32768.0f);
+		*in++ = frames[i].right * (1.0f / 32768.0f);
+	}
+	
+	struct retro_dsp_data data = {
+		.input = snd.dsp_in,
+		.input_frames = frame_count,
+	};
+	retro_dsp_filter_process(snd.dsp, &data);
+	
+	if (data.output_frames>snd.dsp_out_count) {
+		snd.dsp_out_count = data.output_frames;
+		snd.dsp_out = realloc(snd.dsp_out, data.output_frames * sizeof(SND_Frame));
+	}
+	
+	float* samples = data.output;
+	for (int i=0; i<data.output_frames; i++) {
+		snd.dsp_out[i].left  = SND_clamp(*samples++ * 32768.0f);
+		snd.dsp_out[i].right = SND_clamp(*samples++ * 32768.0f);
+	}
+	*out = snd.dsp_out;
+	return data.output_frames;
+}
+#endif
+void SND_setFilter(const char* path) {
+#ifdef HAVE_DSP_FILTER
+	snprintf(snd.dsp_path, sizeof(snd.dsp_path), "%s", path ? path : "");
+	if (snd.sample_rate_out) SND_selectFilter(); // otherwise SND_init() will
+#endif
+}
+
+static int SND_queued(void) { // frames waiting to be played, not counting the SDL period in flight
+#ifdef HAVE_ALSA
+	if (snd.pcm) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(snd.pcm);
+		if (avail<0 || avail>snd.frame_count) return 0; // xrun
+		return snd.frame_count - avail;
 	}
+#endif
+	return __atomic_load_n(&snd.frame_in, __ATOMIC_ACQUIRE) - __atomic_load_n(&snd.frame_out, __ATOMIC_ACQUIRE);
+}
+static void SND_updateRate(void) { // dynamic rate control, keeps the ring about half full
+	int queued = SND_queued();
+	double fill = (double)queued / (snd.frame_target * 2);
+	if (fill>1.0) fill = 1.0;
+	snd.adjust = 1.0 + SND_RATE_CONTROL_DELTA * (1.0 - 2.0 * fill); // over 1 makes more frames when running dry
+	snd.ratio = snd.ratio_base / snd.adjust;
+}
+
+// fast forward plays segments of the (resampled) input and jumps 
+// ahead over whatever playback can't keep up with, so pitch is 
+// unchanged and the producer never waits. skip crossfades the 
+// jumps as is, stretch first looks for the offset that best lines 
+// up with what was playing (wsola without the tempo math, the ring 
+// fill decides how much to skip)
+
+static struct SND_FastForward {
+	int mode; // SND_FF_*
+	SND_Frame buffer[SND_FF_BUFFER];
+	int count;
+	SND_Frame tail[SND_FF_OVERLAP]; // what followed the last segment played
+	int has_tail;
+	float tail_mono[SND_FF_OVERLAP];
+	float mono[SND_FF_SEARCH + SND_FF_OVERLAP];
+	SND_Frame out[SND_FF_SEGMENT];
+} ff;
+
+static int SND_findJoin(const SND_Frame* in) { // offset into in that best continues tail
+	for (int i=0; i<SND_FF_SEARCH+SND_FF_OVERLAP; i++) {
+		ff.mono[i] = in[i].left + in[i].right;
+	}
+	
+	float energy = 0.0f;
+	for (int i=0; i<SND_FF_OVERLAP; i++) {
+		energy += ff.mono[i] * ff.mono[i];
+	}
+	
+	int best = 0;
+	float best_score = -1e30f;
+	for (int k=0; k<SND_FF_SEARCH; k++) {
+		float corr = 0.0f;
+		for (int i=0; i<SND_FF_OVERLAP; i++) { // vectorizes under -Ofast
+			corr += ff.tail_mono[i] * ff.mono[k+i];
+		}
+		// normalized cross correlation, squared to avoid sqrtf
+		float score = (corr>0.0f ? corr * corr : -corr * corr) / (energy + 1.0f);
+		if (score>best_score) {
+			best_score = score;
+			best = k;
+		}
+		energy += ff.mono[k+SND_FF_OVERLAP] * ff.mono[k+SND_FF_OVERLAP] - ff.mono[k] * ff.mono[k];
+		if (energy<0.0f) energy = 0.0f;
+	}
+	return best;
+}
+static void SND_fastForward(const SND_Frame* frames, int count) {
+	while (count>SND_FF_BUFFER/2) { // eg. a whole eq block at once
+		SND_fastForward(frames, SND_FF_BUFFER/2);
+		frames += SND_FF_BUFFER/2;
+		count -= SND_FF_BUFFER/2;
+	}
+	
+	memcpy(ff.buffer + ff.count, frames, count * sizeof(SND_Frame));
+	ff.count += count;
+	
+	// a segment on top of frame_target always fits, so SND_write() never waits
+	int segment = MIN(SND_FF_SEGMENT, snd.frame_target);
+	int need = segment + SND_FF_OVERLAP + SND_FF_SEARCH;
+	int used = 0;
+	while (ff.count-used>=need) {
+		const SND_Frame* in = ff.buffer + used;
+		if (SND_queued()>=snd.frame_target) { // playback's far enough ahead
+			used += segment;
+			continue;
+		}
+		
+		int k = 0;
+		int faded = 0;
+		if (ff.has_tail) {
+			if (ff.mode==SND_FF_STRETCH) k = SND_findJoin(in);
+			for (int i=0; i<SND_FF_OVERLAP; i++) {
+				int j = SND_FF_OVERLAP - i;
+				ff.out[i].left  = (ff.tail[i].left  * j + in[k+i].left  * i) / SND_FF_OVERLAP;
+				ff.out[i].right = (ff.tail[i].right * j + in[k+i].right * i) / SND_FF_OVERLAP;
+			}
+			faded = SND_FF_OVERLAP;
+		}
+		memcpy(ff.out + faded, in + k + faded, (segment - faded) * sizeof(SND_Frame));
+		SND_write(ff.out, segment);
+		
+		memcpy(ff.tail, in + k + segment, SND_FF_OVERLAP * sizeof(SND_Frame));
+		for (int i=0; i<SND_FF_OVERLAP; i++) {
+			ff.tail_mono[i] = ff.tail[i].left + ff.tail[i].right;
+		}
+		ff.has_tail = 1;
+		
+		used += k + segment;
+	}
+	
+	ff.count -= used;
+	memmove(ff.buffer, ff.buffer + used, ff.count * sizeof(SND_Frame));
 }
+void SND_setFastForward(int mode) {
+	if (mode==ff.mode) return;
+	ff.mode = mode;
+	ff.count = 0;
+	ff.has_tail = 0;
+}
+
 size_t SND_batchSamples(const SND_Frame* frames, size_t frame_count) { // plat_sound_write / plat_sound_write_resample
 	if (snd.frame_count==0) return 0;
 	
-	SDL_LockAudio();
-
-	int consumed = 0;
+	size_t consumed = 0;
 	while (frame_count > 0) {
-		int tries = 0;
 		int amount = MIN(BATCH_SIZE, frame_count);
-
-		while (tries < 10 && snd.frame_in==snd.frame_filled) {
-			tries++;
-			SDL_UnlockAudio();
-			SDL_Delay(1);
-			SDL_LockAudio();
-		}
-
-		while (amount && snd.frame_in != snd.frame_filled) {
-			consumed = snd.resample(*frames);
-			frames += consumed;
-			amount -= consumed;
-			frame_count -= consumed;
-		}
+		SND_updateRate();
+		SND_Frame* out = snd.resampled;
+		int count = snd.resample(frames, amount, out);
+#ifdef HAVE_DSP_FILTER
+		if (snd.dsp) count = SND_filter(out, count, &out);
+#endif
+		if (ff.mode) SND_fastForward(out, count);
+		else SND_write(out, count);
+		frames += amount;
+		frame_count -= amount;
+		consumed += amount;
 	}
-	SDL_UnlockAudio();
 	
 	return consumed;
 }
 
-void SND_init(double sample_rate, double frame_rate) { // plat_sound_init
-	LOG_info("SND_init\n");
+int SND_getBufferFill(void) {
+	if (snd.frame_count==0) return 0;
+	int fill = SND_queued() * 50 / snd.frame_target; // 50% is on target
+	return MIN(fill, 100);
+}
+double SND_getRateAdjust(void) {
+	return snd.frame_count ? snd.adjust : 1.0;
+}
+int SND_getUnderruns(void) {
+	return snd.underruns;
+}
+int SND_getOverruns(void) {
+	return snd.overruns;
+}
+
+#ifdef HAVE_ALSA
+static int SND_openALSA(int sample_rate) { // returns 0 to fall back to SDL
+	if (snd_pcm_open(&snd.pcm, SND_ALSA_DEVICE, SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK)<0) {
+		snd.pcm = NULL;
+		return 0;
+	}
+	
+	snd_pcm_hw_params_t* hw;
+	snd_pcm_sw_params_t* sw;
+	snd_pcm_hw_params_alloca(&hw);
+	snd_pcm_sw_params_alloca(&sw);
+	
+	unsigned int rate = sample_rate;
+	snd_pcm_uframes_t period = SND_getPeriod(sample_rate);
+	snd_pcm_uframes_t buffer_size;
+	int dir = 0;
+	
+	if (snd_pcm_hw_params_any(snd.pcm, hw)<0) goto fail;
+	if (snd_pcm_hw_params_set_access(snd.pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)<0) goto fail;
+	if (snd_pcm_hw_params_set_format(snd.pcm, hw, SND_PCM_FORMAT_S16)<0) goto fail;
+	if (snd_pcm_hw_params_set_channels(snd.pcm, hw, 2)<0) goto fail;
+	if (snd_pcm_hw_params_set_rate_near(snd.pcm, hw, &rate, &dir)<0) goto fail;
+	if (snd_pcm_hw_params_set_period_size_near(snd.pcm, hw, &period, &dir)<0) goto fail;
+	
+	snd.sample_rate_out = rate;
+	snd.period = period;
+	SND_updateTarget();
+	
+	// no ring, the pcm's buffer takes its place
+	buffer_size = snd.frame_target * 2;
+	if (snd_pcm_hw_params_set_buffer_size_near(snd.pcm, hw, &buffer_size)<0) goto fail;
+	if (snd_pcm_hw_params(snd.pcm, hw)<0) goto fail;
+	
+	snd.frame_count = buffer_size;
+	snd.frame_target = buffer_size / 2;
+	
+	// start as soon as a period is queued, wake writers a period at a time
+	if (snd_pcm_sw_params_current(snd.pcm, sw)<0) goto fail;
+	if (snd_pcm_sw_params_set_start_threshold(snd.pcm, sw, period)<0) goto fail;
+	if (snd_pcm_sw_params_set_avail_min(snd.pcm, sw, period)<0) goto fail;
+	if (snd_pcm_sw_params(snd.pcm, sw)<0) goto fail;
+	
+	return 1;
+	
+fail:
+	LOG_info("ALSA setup failed, using SDL\n");
+	snd_pcm_close(snd.pcm);
+	snd.pcm = NULL;
+	snd.sample_rate_out = 0;
+	snd.frame_count = 0;
+	return 0;
+}
+#endif
+static void SND_openDevice(void) {
+	int sample_rate = MIN(snd.sample_rate_in, MAX_SAMPLE_RATE); // TODO: always MAX_SAMPLE_RATE on Miyoo Mini? use #ifdef PLATFORM_MIYOOMINI?
+	
+	snd.underruns = 0;
+	snd.overruns = 0;
+	snd.starved = 0;
+	
+#ifdef HAVE_ALSA
+	if (SND_openALSA(sample_rate)) {
+		LOG_info("sample rate: %i (req) %i (rec) period: %i latency: %ims (alsa)\n", snd.sample_rate_in, snd.sample_rate_out, snd.period, snd.latency);
+		SND_selectResampler();
+#ifdef HAVE_DSP_FILTER
+		SND_selectFilter();
+#endif
+		return;
+	}
+#endif
 	
 	SDL_InitSubSystem(SDL_INIT_AUDIO);
 	
-	snd.frame_rate = frame_rate;
-
 	SDL_AudioSpec spec_in;
 	SDL_AudioSpec spec_out;
 	
-	spec_in.freq = MIN(sample_rate, MAX_SAMPLE_RATE); // TODO: always MAX_SAMPLE_RATE on Miyoo Mini? use #ifdef PLATFORM_MIYOOMINI?
+	spec_in.freq = sample_rate;
 	spec_in.format = AUDIO_S16;
 	spec_in.channels = 2;
-	spec_in.samples = 512;
+	spec_in.samples = SND_getPeriod(sample_rate);
 	spec_in.callback = SND_audioCallback;
 	
 	SDL_OpenAudio(&spec_in, &spec_out);
 	
-	snd.buffer_seconds = 5;
-	snd.sample_rate_in  = sample_rate;
 	snd.sample_rate_out = spec_out.freq;
+	snd.period = spec_out.samples;
 	
-	LOG_info("sample rate: %i (req) %i (rec)\n", snd.sample_rate_in, snd.sample_rate_out);
+	LOG_info("sample rate: %i (req) %i (rec) period: %i latency: %ims\n", snd.sample_rate_in, snd.sample_rate_out, snd.period, snd.latency);
 	
 	SND_selectResampler();
+#ifdef HAVE_DSP_FILTER
+	SND_selectFilter();
+#endif
 	SND_resizeBuffer();
 	
 	SDL_PauseAudio(0);
 }
-void SND_quit(void) { // plat_sound_finish
+static void SND_closeDevice(void) {
+#ifdef HAVE_ALSA
+	if (snd.pcm) {
+		snd_pcm_drop(snd.pcm);
+		snd_pcm_close(snd.pcm);
+		snd.pcm = NULL;
+		return;
+	}
+#endif
 	SDL_PauseAudio(1);
 	SDL_CloseAudio();
+}
+void SND_setLatency(int ms) {
+	if (ms==snd.latency) return;
+	snd.latency = ms;
+	if (!snd.sample_rate_out) return; // otherwise SND_init() will
+	
+	SND_closeDevice();
+	SND_openDevice();
+}
+
+void SND_init(double sample_rate, double frame_rate) { // plat_sound_init
+	LOG_info("SND_init\n");
+	
+	snd.frame_rate = frame_rate;
+	snd.sample_rate_in = sample_rate;
+	if (!snd.latency) snd.latency = SND_LATENCY_DEFAULT;
+	
+	SND_openDevice();
+}
+void SND_quit(void) { // plat_sound_finish
+	SND_closeDevice();
 	
 	if (snd.buffer) {
 		free(snd.buffer);
 		snd.buffer = NULL;
 	}
+	if (snd.resampled) {
+		free(snd.resampled);
+		snd.resampled = NULL;
+	}
+#ifdef HAVE_SINC_RESAMPLER
+	SND_freeSinc();
+#endif
+#ifdef HAVE_DSP_FILTER
+	SND_freeFilter();
+#endif
+	snd.frame_count = 0;
+	snd.sample_rate_out = 0;
 }
 
 ///////////////////////////////
 
+#define INPUT_COUNT 4
+
 static struct PAD_Context {
 	int is_pressed;
 	int just_pressed;
 	int just_released;
 	int just_repeated;
 	uint32_t repeat_at[BTN_ID_COUNT];
+	
+	int inputs_opened;
+	int input_count;
+	int input_fds[INPUT_COUNT];
+	uint32_t input_at; // last time anything happened
 } pad;
 #define PAD_REPEAT_DELAY	300
 #define PAD_REPEAT_INTERVAL 100
+#define PAD_WAIT_DELAY 250 // keep polling every frame this long after input
 void PAD_reset(void) {
 	pad.just_pressed = BTN_NONE;
 	pad.is_pressed = BTN_NONE;
@@ -1246,9 +2569,51 @@ void PAD_poll(void) {
 			pad.is_pressed		|= btn; // set
 			pad.repeat_at[id]	= tick + PAD_REPEAT_DELAY;
 		}
+		pad.input_at = tick;
 	}
 }
 
+static void PAD_openInputs(void) {
+	// only used to wake up, SDL still reads the actual events
+	pad.inputs_opened = 1;
+	char path[32];
+	for (int i=0; i<INPUT_COUNT; i++) {
+		sprintf(path, "/dev/input/event%i", i);
+		int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd>=0) pad.input_fds[pad.input_count++] = fd;
+	}
+}
+int PAD_wait(int timeout) {
+	if (!pad.inputs_opened) PAD_openInputs();
+	if (!pad.input_count) return 0;
+	
+	// SDL might not have seen the event that woke us yet
+	uint32_t now = SDL_GetTicks();
+	if (now-pad.input_at<PAD_WAIT_DELAY) return 0;
+	
+	// held buttons repeat
+	for (int i=0; i<BTN_ID_COUNT; i++) {
+		if (!(pad.is_pressed & (1 << i))) continue;
+		int until = (int32_t)(pad.repeat_at[i] - now);
+		if (until<0) until = 0;
+		if (timeout<0 || until<timeout) timeout = until;
+	}
+	
+	struct pollfd fds[INPUT_COUNT];
+	for (int i=0; i<pad.input_count; i++) {
+		fds[i].fd = pad.input_fds[i];
+		fds[i].events = POLLIN;
+	}
+	if (poll(fds, pad.input_count, timeout)>0) {
+		char buffer[256];
+		for (int i=0; i<pad.input_count; i++) {
+			while (read(pad.input_fds[i], buffer, sizeof(buffer))>0); // drain
+		}
+		pad.input_at = SDL_GetTicks();
+	}
+	return 1;
+}
+
 int PAD_anyPressed(void)		{ return pad.is_pressed!=BTN_NONE; }
 int PAD_justPressed(int btn)	{ return pad.just_pressed & btn; }
 int PAD_isPressed(int btn)		{ return pad.is_pressed & btn; }
@@ -1416,6 +2781,7 @@ int POW_readBatteryStatus(void) {
 
 static void POW_updateBatteryStatus(void) {
 	pow.is_charging = getInt("/sys/class/power_supply/battery/charger_online");
+	pow.battery_at = SDL_GetTicks();
 
 	int i = POW_readBatteryStatus();
 
@@ -1433,11 +2799,12 @@ static void POW_updateBatteryStatus(void) {
 	de_enable_overlay = pow.should_warn && pow.charge<=POW_LOW_CHARGE;
 }
 
+#define BATTERY_DELAY 30 // seconds
 static void* POW_monitorBattery(void *arg) {
 	while(1) {
 		// TODO: the frequency of checking should depend on whether 
 		// we're in game (less frequent) or menu (more frequent)
-		sleep(30);
+		sleep(BATTERY_DELAY);
 		POW_updateBatteryStatus();
 	}
 	return NULL;
@@ -1540,6 +2907,14 @@ void POW_update(int* _dirty, int* _show_setting, POW_callback_t before_sleep, PO
 	}
 	if (show_setting) dirty = 1; // shm is slow or keymon is catching input on the next frame
 
+	// for GFX_idle(), is_charging only changes when POW_monitorBattery() runs
+	uint32_t update_at = pow.battery_at + BATTERY_DELAY * 1000 + 100;
+	if (!POW_preventAutosleep() && (int32_t)(cancel_start + SLEEP_DELAY - update_at)<0) update_at = cancel_start + SLEEP_DELAY;
+	if (power_start && (int32_t)(power_start + 1000 - update_at)<0) update_at = power_start + 1000;
+	if (show_setting && (int32_t)(setting_start + SETTING_DELAY - update_at)<0) update_at = setting_start + SETTING_DELAY;
+	if (!show_setting && PAD_isPressed(BTN_MENU) && (int32_t)(menu_start + MENU_DELAY - update_at)<0) update_at = menu_start + MENU_DELAY;
+	pow.update_at = update_at ? update_at : 1;
+	
 	if (_dirty) *_dirty = dirty;
 	if (_show_setting) *_show_setting = show_setting;
 }
@@ -27,8 +27,10 @@ void LOG_note(int level, const char* fmt, ...);
 #define FIXED_PITCH		(FIXED_WIDTH * FIXED_BPP)
 #define FIXED_SIZE		(FIXED_PITCH * FIXED_HEIGHT)
 
-#define PAGE_COUNT	2
-#define PAGE_SCALE	3
+#ifndef PAGE_COUNT
+#define PAGE_COUNT	3 // 2 or more, 3 always leaves the scaler a free page
+#endif
+#define PAGE_SCALE	3 // the largest pages GFX_resize() will grow to
 #define PAGE_WIDTH	(FIXED_WIDTH * PAGE_SCALE)
 #define PAGE_HEIGHT	(FIXED_HEIGHT * PAGE_SCALE)
 #define PAGE_PITCH	(PAGE_WIDTH * FIXED_BPP)
@@ -78,11 +80,12 @@ enum {
 	ASSET_SCROLL_DOWN,
 };
 
+typedef struct GFX_Font GFX_Font; // only opens FONT_PATH when text leaves the font atlas
 typedef struct GFX_Fonts {
-	TTF_Font* large; 	// menu
-	TTF_Font* medium; 	// single char button label
-	TTF_Font* small; 	// button hint
-	TTF_Font* tiny; 	// multi char button label
+	GFX_Font* large; 	// menu
+	GFX_Font* medium; 	// single char button label
+	GFX_Font* small; 	// button hint
+	GFX_Font* tiny; 	// multi char button label
 } GFX_Fonts;
 extern GFX_Fonts font;
 
@@ -92,7 +95,7 @@ enum {
 };
 
 SDL_Surface* GFX_init(int mode);
-SDL_Surface* GFX_resize(int width, int height, int pitch);
+SDL_Surface* GFX_resize(int width, int height, int pitch); // NULL if the pages couldn't grow to fit, the old screen stays valid
 void GFX_setScaleClip(int x, int y, int width, int height);
 void GFX_setNearestNeighbor(int enabled);
 void GFX_setMode(int mode);
@@ -101,6 +104,7 @@ void GFX_clearAll(void);
 void GFX_startFrame(void);
 void GFX_flip(SDL_Surface* screen);
 void GFX_sync(void); // call this to maintain 60fps when not calling GFX_flip() this frame
+void GFX_idle(void); // like GFX_sync() but sleeps until input or the next POW_update() deadline when nothing is changing
 void GFX_quit(void);
 
 enum {
@@ -111,10 +115,14 @@ enum {
 
 int GFX_getVsync(void);
 void GFX_setVsync(int vsync);
+void GFX_setThreaded(int enabled); // vsync wait and page swap move to a present thread
+void GFX_waitPage(void); // when threaded, call before drawing to the backbuffer
 
 SDL_Surface* GFX_getBufferCopy(void); // must be freed by caller
-int GFX_truncateText(TTF_Font* font, const char* in_name, char* out_name, int max_width, int padding); // returns final width
-int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines);
+uint32_t GFX_getReserved(void); // bytes of ION memory held by the pages
+uint32_t GFX_getPageLimit(void); // largest page GFX_resize() can still grow to
+int GFX_truncateText(GFX_Font* font, const char* in_name, char* out_name, int max_width, int padding); // returns final width
+int GFX_wrapText(GFX_Font* font, char* str, int max_width, int max_lines);
 
 // NOTE: all dimensions should be pre-scaled
 void GFX_blitAsset(int asset, SDL_Rect* src_rect, SDL_Surface* dst, SDL_Rect* dst_rect);
@@ -123,13 +131,18 @@ void GFX_blitRect(int asset, SDL_Surface* dst, SDL_Rect* dst_rect);
 void GFX_blitBattery(SDL_Surface* dst, SDL_Rect* dst_rect);
 int GFX_getButtonWidth(char* hint, char* button);
 void GFX_blitButton(char* hint, char*button, SDL_Surface* dst, SDL_Rect* dst_rect);
-void GFX_blitMessage(TTF_Font* font, char* msg, SDL_Surface* dst, SDL_Rect* dst_rect);
+void GFX_blitMessage(GFX_Font* font, char* msg, SDL_Surface* dst, SDL_Rect* dst_rect);
 
 int GFX_blitHardwareGroup(SDL_Surface* dst, int show_setting);
 int GFX_blitButtonGroup(char** hints, SDL_Surface* dst, int align_right);
 
-void GFX_sizeText(TTF_Font* font, char* str, int leading, int* w, int* h);
-void GFX_blitText(TTF_Font* font, char* str, int leading, SDL_Color color, SDL_Surface* dst, SDL_Rect* dst_rect);
+SDL_Surface* GFX_renderText(GFX_Font* font, const char* str, SDL_Color color); // like TTF_RenderUTF8_Blended() but from the font atlas, must be freed by caller
+int GFX_getTextWidth(GFX_Font* font, const char* str); // like TTF_SizeUTF8() but from the font atlas
+SDL_Surface* GFX_getText(GFX_Font* font, const char* str, SDL_Color color); // cached, do not free, valid until the next GFX_getText() at least
+void GFX_clearTextCache(void);
+
+void GFX_sizeText(GFX_Font* font, char* str, int leading, int* w, int* h);
+void GFX_blitText(GFX_Font* font, char* str, int leading, SDL_Color color, SDL_Surface* dst, SDL_Rect* dst_rect);
 
 ///////////////////////////////
 
@@ -138,8 +151,28 @@ typedef struct SND_Frame {
 	int16_t right;
 } SND_Frame;
 
+enum {
+	SND_RESAMPLER_NEAREST,
+	SND_RESAMPLER_LINEAR,
+	SND_RESAMPLER_CUBIC,
+	SND_RESAMPLER_SINC, // only when built with HAVE_SINC_RESAMPLER, otherwise cubic
+};
+
 void SND_init(double sample_rate, double frame_rate);
+void SND_setResampler(int resampler, int quality); // quality is sinc only, 0 (lowest) to 4 (highest)
+void SND_setLatency(int ms); // reopens the device if already open
+enum {
+	SND_FF_OFF,
+	SND_FF_SKIP, // jump ahead with a crossfade
+	SND_FF_STRETCH, // jump to the best matching offset, smoother
+};
+void SND_setFastForward(int mode); // keeps pitch and never blocks the caller
+void SND_setFilter(const char* path); // libretro .dsp preset, NULL for none, only when built with HAVE_DSP_FILTER
 size_t SND_batchSamples(const SND_Frame* frames, size_t frame_count);
+int SND_getBufferFill(void); // percent, 50 is on the latency target
+double SND_getRateAdjust(void); // dynamic rate control, 1.0 is none
+int SND_getUnderruns(void);
+int SND_getOverruns(void);
 void SND_quit(void);
 
 ///////////////////////////////
@@ -195,6 +228,7 @@ enum {
 
 void PAD_reset(void);
 void PAD_poll(void);
+int PAD_wait(int timeout); // sleeps until input, a button repeat or timeout ms (-1 for none), returns 0 if it can't
 int PAD_anyPressed(void);
 int PAD_justPressed(int btn);
 int PAD_isPressed(int btn);
@@ -46,7 +46,9 @@
 
 #define MAX_PATH 512
 
+#ifndef SDCARD_PATH // overridden by minui's bench target
 #define SDCARD_PATH "/mnt/sdcard"
+#endif
 #define ROMS_PATH SDCARD_PATH "/Roms"
 #define ROOT_SYSTEM_PATH SDCARD_PATH "/.system/"
 #define SYSTEM_PATH SDCARD_PATH "/.system/" PLATFORM
@@ -59,7 +61,10 @@
 #define FAVORITE_PATH USERDATA_PATH "/.minui/favorite.txt"
 #define FAUX_FAVORITE_PATH SDCARD_PATH "/Favourites"
 #define COLLECTIONS_PATH SDCARD_PATH "/Collections"
+#define INDEX_PATH USERDATA_PATH "/.minui/index"
+#define FONT_ATLAS_PATH USERDATA_PATH "/.minui/font.atlas"
 #define BATTERY_PATH USERDATA_PATH "/battery.txt"
+#define LOGS_PATH USERDATA_PATH "/logs" // also in MinUI.pak/launch.sh
 
 #define LAST_PATH "/tmp/last.txt" // transient
 #define CHANGE_DISC_PATH "/tmp/change_disc.txt"
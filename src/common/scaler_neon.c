@@ -1,6 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <arm_neon.h>
+#include "scaler_neon.h"
 
 //
 //	arm NEON / C integer scalers for ARMv7 devices
@@ -2776,6 +2779,284 @@ void scale6x5_n32(void* __restrict src, void* __restrict dst, uint32_t sw, uint3
 void scale6x6_n32(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp) {
 	scale6x_n32(src, dst, sw, sh, sp, dp, 6); }
 
+//
+//	NEON effect scalers (16bpp only)
+//	8 src pixels per block, the effect is applied while scaling and the
+//	blends are fixed-point multiply-shifts instead of minarch's / 3 and / 5
+//
+
+//	each RGB565 channel becomes (c*ca + add) * m >> 10, m=205 is /5 and m=256 is /4,
+//	exact for the channel ranges involved so the output matches the scalar
+//	Weight* macros the effects used to be built from (from gambatte-dms), eg.
+//	#define Weight3_2(A, B)  (((((cR(B) << 1) + (cR(A) * 3)) / 5) & 0x1f) << 11 | ((((cG(B) << 1) + (cG(A) * 3)) / 5) & 0x3f) << 5 | ((((cB(B) << 1) + (cB(A) * 3)) / 5) & 0x1f))
+//	with cR(A) (((A) & 0xf800) >> 11), cG(A) (((A) & 0x7e0) >> 5) and cB(A) ((A) & 0x1f)
+static inline uint16x8_t blend_n16(uint16x8_t c, uint16_t ca, uint16_t add5, uint16_t add6, uint16_t m) {
+	uint16x8_t r = vshrq_n_u16(c, 11);
+	uint16x8_t g = vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x3f));
+	uint16x8_t b = vandq_u16(c, vdupq_n_u16(0x1f));
+	r = vshrq_n_u16(vmulq_n_u16(vmlaq_n_u16(vdupq_n_u16(add5), r, ca), m), 10);
+	g = vshrq_n_u16(vmulq_n_u16(vmlaq_n_u16(vdupq_n_u16(add6), g, ca), m), 10);
+	b = vshrq_n_u16(vmulq_n_u16(vmlaq_n_u16(vdupq_n_u16(add5), b, ca), m), 10);
+	return vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b);
+}
+#define dim3_4_n16(c) blend_n16(c, 3, 0, 0, 256)		// Weight3_1(c, black)
+#define dim3_5_n16(c) blend_n16(c, 3, 0, 0, 205)		// Weight3_2(c, black)
+#define dim2_5_n16(c) blend_n16(c, 2, 0, 0, 205)		// Weight2_3(c, black)
+#define tint3_5_n16(c) blend_n16(c, 3, 2*31, 2*63, 205)	// Weight3_2(c, white)
+#define tint2_5_n16(c) blend_n16(c, 2, 3*31, 3*63, 205)	// Weight2_3(c, white)
+
+#define ROW_N16(d,dp,r) ((uint16_t*)((uint8_t*)(d) + (dp)*(r)))
+#define STORE2_N16(d,a,b) vst2q_u16(d, (uint16x8x2_t){{a,b}})
+#define STORE3_N16(d,a,b,c) vst3q_u16(d, (uint16x8x3_t){{a,b,c}})
+#define STORE4_N16(d,a,b,c,e) vst4q_u16(d, (uint16x8x4_t){{a,b,c,e}})
+
+//	runs block over each row 8 src pixels at a time, a ragged
+//	right edge goes through a zero padded scratch block
+#define EFFECT_N16(name, mul, block) \
+void name(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp) { \
+	if (!sw||!sh) return; \
+	if (!sp) { sp = sw*sizeof(uint16_t); } if (!dp) { dp = sw*sizeof(uint16_t)*mul; } \
+	for (uint32_t y=0; y<sh; y++) { \
+		uint16_t* s = (uint16_t*)((uint8_t*)src + sp*y); \
+		uint16_t* d = (uint16_t*)((uint8_t*)dst + dp*mul*y); \
+		uint32_t x = 0; \
+		for (; x+8<=sw; x+=8) block(s+x, d+x*mul, dp, y); \
+		if (x<sw) { \
+			uint16_t ts[8] = {0}; \
+			uint16_t td[mul][8*mul]; \
+			memcpy(ts, s+x, (sw-x)*sizeof(uint16_t)); \
+			block(ts, td[0], sizeof(td[0]), y); \
+			for (uint32_t r=0; r<mul; r++) memcpy(ROW_N16(d+x*mul,dp,r), td[r], (sw-x)*sizeof(uint16_t)*mul); \
+		} \
+	} \
+}
+
+static inline void scale1x_scanline_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c = vld1q_u16(s);
+	vst1q_u16(d, (y&1) ? dim3_4_n16(c) : c);
+}
+EFFECT_N16(scale1x_scanline_n16, 1, scale1x_scanline_block)
+
+static inline void scale2x_lcd_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c = vld1q_u16(s);
+	uint16x8_t r = vandq_u16(c, vdupq_n_u16(0xf800));
+	uint16x8_t g = vandq_u16(c, vdupq_n_u16(0x07e0));
+	uint16x8_t b = vandq_u16(c, vdupq_n_u16(0x001f));
+	uint16x8_t k = vdupq_n_u16(0);
+	STORE2_N16(ROW_N16(d,dp,0), r, b);
+	STORE2_N16(ROW_N16(d,dp,1), g, k);
+}
+EFFECT_N16(scale2x_lcd_n16, 2, scale2x_lcd_block)
+
+static inline void scale2x_scanline_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c1 = vld1q_u16(s);
+	uint16x8_t c2 = dim3_5_n16(c1);
+	STORE2_N16(ROW_N16(d,dp,0), c1, c1);
+	STORE2_N16(ROW_N16(d,dp,1), c2, c2);
+}
+EFFECT_N16(scale2x_scanline_n16, 2, scale2x_scanline_block)
+
+static inline void scale2x_grid_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c1 = vld1q_u16(s);
+	uint16x8_t c2 = dim3_4_n16(c1);
+	STORE2_N16(ROW_N16(d,dp,0), c2, c2);
+	STORE2_N16(ROW_N16(d,dp,1), c2, c1);
+}
+EFFECT_N16(scale2x_grid_n16, 2, scale2x_grid_block)
+
+static inline void scale3x_lcd_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c = vld1q_u16(s);
+	uint16x8_t r = vandq_u16(c, vdupq_n_u16(0xf800));
+	uint16x8_t g = vandq_u16(c, vdupq_n_u16(0x07e0));
+	uint16x8_t b = vandq_u16(c, vdupq_n_u16(0x001f));
+	uint16x8_t k = vdupq_n_u16(0);
+	STORE3_N16(ROW_N16(d,dp,0), k, g, k);
+	STORE3_N16(ROW_N16(d,dp,1), r, g, b);
+	STORE3_N16(ROW_N16(d,dp,2), r, k, b);
+}
+EFFECT_N16(scale3x_lcd_n16, 3, scale3x_lcd_block)
+
+static inline void scale3x_dmg_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t a = vld1q_u16(s);
+	uint16x8_t b = tint3_5_n16(a);
+	uint16x8_t c = tint2_5_n16(a);
+	STORE3_N16(ROW_N16(d,dp,0), b, a, a);
+	STORE3_N16(ROW_N16(d,dp,1), b, a, a);
+	STORE3_N16(ROW_N16(d,dp,2), c, b, b);
+}
+EFFECT_N16(scale3x_dmg_n16, 3, scale3x_dmg_block)
+
+static inline void scale3x_scanline_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c1 = vld1q_u16(s);
+	uint16x8_t c2 = dim3_5_n16(c1);
+	STORE3_N16(ROW_N16(d,dp,0), c2, c2, c2);
+	STORE3_N16(ROW_N16(d,dp,1), c1, c1, c1);
+	STORE3_N16(ROW_N16(d,dp,2), c1, c1, c1);
+}
+EFFECT_N16(scale3x_scanline_n16, 3, scale3x_scanline_block)
+
+static inline void scale3x_grid_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c1 = vld1q_u16(s);
+	uint16x8_t c2 = dim3_5_n16(c1);
+	uint16x8_t c3 = dim2_5_n16(c1);
+	STORE3_N16(ROW_N16(d,dp,0), c2, c1, c1);
+	STORE3_N16(ROW_N16(d,dp,1), c2, c1, c1);
+	STORE3_N16(ROW_N16(d,dp,2), c3, c2, c2);
+}
+EFFECT_N16(scale3x_grid_n16, 3, scale3x_grid_block)
+
+static inline void scale4x_scanline_block(uint16_t* s, uint16_t* d, uint32_t dp, uint32_t y) {
+	uint16x8_t c1 = vld1q_u16(s);
+	uint16x8_t c2 = dim3_5_n16(c1);
+	STORE4_N16(ROW_N16(d,dp,0), c1, c1, c1, c1);
+	STORE4_N16(ROW_N16(d,dp,1), c2, c2, c2, c2);
+	STORE4_N16(ROW_N16(d,dp,2), c1, c1, c1, c1);
+	STORE4_N16(ROW_N16(d,dp,3), c2, c2, c2, c2);
+}
+EFFECT_N16(scale4x_scanline_n16, 4, scale4x_scanline_block)
+
+//
+//	NEON fractional nearest neighbor (16bpp only)
+//	same DDA as minarch's old scaleNN* loops but walked once per width into a
+//	column lookup, then each row is a vtbl gather of 8 dst pixels from a 16 byte
+//	src window and repeated rows are memcpy_neon'd
+//
+
+void scaleNN_cols_n16(scaleNN_cols_t* cols, uint32_t sw, uint32_t dw) {
+	if (cols->sw==sw && cols->dw==dw) return;
+	cols->sw = sw;
+	cols->dw = dw;
+	if (!sw||!dw) return;
+	
+	uint32_t blocks = (dw + 7) / 8;
+	cols->col = realloc(cols->col, dw * sizeof(uint16_t));
+	cols->base = realloc(cols->base, blocks * sizeof(uint16_t));
+	cols->idx = realloc(cols->idx, blocks * 16);
+	cols->fix = realloc(cols->fix, dw * sizeof(*cols->fix));
+	cols->fix_count = 0;
+	
+	// l1/l2 track which src pixels the text heuristic would be comparing
+	int dx = -dw;
+	int l1 = -1;
+	int l2 = -1;
+	uint32_t x = 0;
+	for (uint32_t i=0; i<sw; i++) {
+		int first = 1;
+		while (dx<0) {
+			if (first && i>0 && l1!=l2) cols->fix[cols->fix_count++] = (typeof(*cols->fix)){x, l1, l2};
+			cols->col[x++] = i;
+			dx += sw;
+			l2 = l1;
+			l1 = i;
+			first = 0;
+		}
+		dx -= dw;
+	}
+	
+	cols->windowed = sw>=8 && dw>=8;
+	for (uint32_t b=0; b<blocks && cols->windowed; b++) {
+		uint32_t x0 = b<blocks-1 ? b*8 : dw-8; // last block overlaps the one before
+		uint32_t base = cols->col[x0];
+		if (base>sw-8) base = sw-8; // don't read past the end of the row
+		cols->base[b] = base;
+		for (uint32_t j=0; j<8; j++) {
+			uint32_t o = cols->col[x0+j] - base;
+			if (o>7) { cols->windowed = 0; break; } // downscaling
+			cols->idx[b*16 + j*2    ] = o*2;
+			cols->idx[b*16 + j*2 + 1] = o*2 + 1;
+		}
+	}
+}
+static inline void scaleNN_row_n16(uint16_t* s, uint16_t* d, scaleNN_cols_t* cols, uint32_t text) {
+	uint32_t dw = cols->dw;
+	if (cols->windowed) {
+		uint32_t blocks = (dw + 7) / 8;
+		for (uint32_t b=0; b<blocks; b++) {
+			uint32_t x0 = b<blocks-1 ? b*8 : dw-8;
+			uint8x16_t w = vld1q_u8((uint8_t*)(s + cols->base[b]));
+			uint8x16_t i = vld1q_u8(cols->idx + b*16);
+			uint8x8x2_t t = {{ vget_low_u8(w), vget_high_u8(w) }};
+			vst1q_u8((uint8_t*)(d + x0), vcombine_u8(vtbl2_u8(t, vget_low_u8(i)), vtbl2_u8(t, vget_high_u8(i))));
+		}
+	}
+	else {
+		for (uint32_t x=0; x<dw; x++) d[x] = s[cols->col[x]];
+	}
+	
+	if (!text) return;
+	
+	// keep a consistent stroke width by stretching bright pixels 
+	// that only got one column into the next src pixel's first
+	for (uint32_t f=0; f<cols->fix_count; f++) {
+		uint16_t l1 = cols->fix[f].l1<0 ? 0 : s[cols->fix[f].l1];
+		uint16_t l2 = cols->fix[f].l2<0 ? 0 : s[cols->fix[f].l2];
+		if (l1==l2) continue;
+		
+		// https://stackoverflow.com/a/71086522/145965
+		uint16_t r = (l1 >> 10) & 0x3E;
+		uint16_t g = (l1 >> 5) & 0x3F;
+		uint16_t b = (l1 << 1) & 0x3E;
+		uint16_t luma = (r * 218) + (g * 732) + (b * 74);
+		luma = (luma >> 10) + ((luma >> 9) & 1); // 0-63
+		if (luma>24) d[cols->fix[f].x] = l1;
+	}
+}
+void scaleNN_n16(void* __restrict src, void* __restrict dst, uint32_t sh, uint32_t sp, uint32_t dh, uint32_t dp, scaleNN_cols_t* cols, uint32_t text, uint32_t scanline) {
+	if (!cols->sw||!cols->dw||!sh||!dh) return;
+	uint32_t cpy_w = cols->dw * sizeof(uint16_t);
+	int aligned = !((uintptr_t)dst&3) && !(dp&3); // for memcpy_neon
+	
+	int dy = -dh;
+	if (scanline) { // every other dst row stays black
+		void* drawn = NULL; // src row last gathered
+		for (uint32_t row=0; row<dh; row++) {
+			if (row%2==0) {
+				if (drawn==src) {
+					void* prev = (uint8_t*)dst - dp*2;
+					if (aligned) memcpy_neon(dst, prev, cpy_w);
+					else memcpy(dst, prev, cpy_w);
+				}
+				else scaleNN_row_n16(src, dst, cols, text);
+				drawn = src;
+			}
+			dst = (uint8_t*)dst + dp;
+			dy += sh;
+			while (dy>=0) { // skips src rows when shrinking
+				dy -= dh;
+				src = (uint8_t*)src + sp;
+			}
+		}
+		return;
+	}
+	
+	uint32_t lines = sh;
+	int copy = 0;
+	while (lines) {
+		if (copy) {
+			copy = 0;
+			void* prev = (uint8_t*)dst - dp;
+			if (aligned) memcpy_neon(dst, prev, cpy_w);
+			else memcpy(dst, prev, cpy_w);
+			dst = (uint8_t*)dst + dp;
+			dy += sh;
+		}
+		else if (dy<0) {
+			scaleNN_row_n16(src, dst, cols, text);
+			dst = (uint8_t*)dst + dp;
+			dy += sh;
+		}
+		
+		if (dy>=0) {
+			dy -= dh;
+			src = (uint8_t*)src + sp;
+			lines--;
+		}
+		else {
+			copy = 1;
+		}
+	}
+}
+
 static void dummy(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp) {}
 
 void scaler_n16(uint32_t xmul, uint32_t ymul, void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp) {
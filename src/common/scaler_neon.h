@@ -101,6 +101,32 @@ void scale6x5_n32(void* __restrict src, void* __restrict dst, uint32_t sw, uint3
 void scale6x6_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
 void scale6x6_n32(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
 
+//	NEON effect scalers (16bpp only, blends match minarch's Weight* macros)
+void scale1x_scanline_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale2x_lcd_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale2x_scanline_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale2x_grid_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale3x_lcd_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale3x_dmg_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale3x_scanline_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale3x_grid_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+void scale4x_scanline_n16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp);
+
+//	NEON fractional nearest neighbor (16bpp only)
+//	the column lookup is built once per src/dst width, eg. at selectScaler time
+typedef struct scaleNN_cols {
+	uint32_t sw;
+	uint32_t dw;
+	uint16_t* col;		// src pixel for each dst pixel
+	uint16_t* base;		// src pixel each block of 8 dst pixels gathers from
+	uint8_t* idx;		// byte offsets into that block's 16 byte window
+	uint32_t windowed;	// every block fits its window (upscaling), otherwise gather from col
+	uint32_t fix_count;
+	struct { uint16_t x; int16_t l1; int16_t l2; }* fix; // for text, -1 is black
+} scaleNN_cols_t;
+void scaleNN_cols_n16(scaleNN_cols_t* cols, uint32_t sw, uint32_t dw);
+void scaleNN_n16(void* __restrict src, void* __restrict dst, uint32_t sh, uint32_t sp, uint32_t dh, uint32_t dp, scaleNN_cols_t* cols, uint32_t text, uint32_t scanline);
+
 //	C scalers
 void scale1x_c16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp, uint32_t ymul);
 void scale1x_c32(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dp, uint32_t ymul);
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+#include "strmap.h"
+
+///////////////////////////////////////
+
+#define STRMAP_MIN_CAPACITY 16
+
+uint32_t StrMap_hash(const char* key) {
+	uint32_t hash = 2166136261u; // FNV-1a
+	while (*key) {
+		hash ^= (uint8_t)*key++;
+		hash *= 16777619u;
+	}
+	return hash ? hash : 1; // 0 marks an empty slot
+}
+
+static void StrMap_alloc(StrMap* self, int capacity) {
+	self->count = 0;
+	self->capacity = capacity;
+	self->slots = calloc(capacity, sizeof(StrMapSlot));
+}
+static void StrMap_insert(StrMap* self, uint32_t hash, char* key, void* value) { // key must not exist yet
+	uint32_t mask = self->capacity - 1;
+	uint32_t i = hash & mask;
+	while (self->slots[i].hash) i = (i + 1) & mask;
+	self->slots[i].hash = hash;
+	self->slots[i].key = key;
+	self->slots[i].value = value;
+	self->count += 1;
+}
+static void StrMap_grow(StrMap* self) {
+	StrMapSlot* slots = self->slots;
+	int capacity = self->capacity;
+	StrMap_alloc(self, capacity * 2);
+	for (int i=0; i<capacity; i++) {
+		if (slots[i].hash) StrMap_insert(self, slots[i].hash, slots[i].key, slots[i].value);
+	}
+	free(slots);
+}
+static int StrMap_find(StrMap* self, uint32_t hash, const char* key) {
+	uint32_t mask = self->capacity - 1;
+	uint32_t i = hash & mask;
+	while (self->slots[i].hash) {
+		StrMapSlot* slot = &self->slots[i];
+		if (slot->hash==hash && strcmp(slot->key, key)==0) return i;
+		i = (i + 1) & mask;
+	}
+	return -1;
+}
+
+///////////////////////////////////////
+
+StrMap* StrMap_new(int capacity) {
+	int size = STRMAP_MIN_CAPACITY;
+	while (size<capacity * 4 / 3) size *= 2; // room to stay under 75% full
+	
+	StrMap* self = malloc(sizeof(StrMap));
+	StrMap_alloc(self, size);
+	return self;
+}
+void StrMap_free(StrMap* self) {
+	free(self->slots);
+	free(self);
+}
+void StrMap_clear(StrMap* self) {
+	memset(self->slots, 0, sizeof(StrMapSlot) * self->capacity);
+	self->count = 0;
+}
+
+void* StrMap_get(StrMap* self, const char* key) {
+	int i = StrMap_find(self, StrMap_hash(key), key);
+	return i==-1 ? NULL : self->slots[i].value;
+}
+void StrMap_set(StrMap* self, char* key, void* value) {
+	uint32_t hash = StrMap_hash(key);
+	int i = StrMap_find(self, hash, key);
+	if (i!=-1) {
+		self->slots[i].value = value; // keeps the existing key
+		return;
+	}
+	if ((self->count + 1) * 4 > self->capacity * 3) StrMap_grow(self);
+	StrMap_insert(self, hash, key, value);
+}
+void* StrMap_remove(StrMap* self, const char* key) {
+	int i = StrMap_find(self, StrMap_hash(key), key);
+	if (i==-1) return NULL;
+	
+	void* value = self->slots[i].value;
+	
+	// backward shift deletion, no tombstones
+	uint32_t mask = self->capacity - 1;
+	uint32_t hole = i;
+	uint32_t j = i;
+	while (1) {
+		j = (j + 1) & mask;
+		StrMapSlot* slot = &self->slots[j];
+		if (!slot->hash) break;
+		uint32_t home = slot->hash & mask;
+		// can this slot move into the hole without passing its home?
+		if (((j - home) & mask) >= ((j - hole) & mask)) {
+			self->slots[hole] = *slot;
+			hole = j;
+		}
+	}
+	self->slots[hole].hash = 0;
+	self->slots[hole].key = NULL;
+	self->slots[hole].value = NULL;
+	self->count -= 1;
+	return value;
+}
@@ -0,0 +1,31 @@
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#include <stdint.h>
+
+// open addressing (linear probing) string -> pointer map
+// keys are borrowed, they must outlive their slot (or be freed by the owner after StrMap_remove())
+
+typedef struct StrMapSlot {
+	uint32_t hash; // 0 means empty
+	char* key;
+	void* value;
+} StrMapSlot;
+
+typedef struct StrMap {
+	int count;
+	int capacity; // always a power of 2
+	StrMapSlot* slots;
+} StrMap;
+
+uint32_t StrMap_hash(const char* key);
+
+StrMap* StrMap_new(int capacity);
+void StrMap_free(StrMap* self);
+void StrMap_clear(StrMap* self);
+
+void* StrMap_get(StrMap* self, const char* key); // NULL if missing
+void StrMap_set(StrMap* self, char* key, void* value); // replaces an existing value but keeps its key
+void* StrMap_remove(StrMap* self, const char* key); // returns the removed value
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "defines.h"
+#include "utils.h"
+#include "trace.h"
+
+///////////////////////////////////////
+
+enum {
+	TRACE_EVENT_BEGIN = 'B',
+	TRACE_EVENT_END = 'E',
+	TRACE_EVENT_MARK = 'I',
+};
+
+static struct Trace {
+	char name[64];
+	uint64_t start;
+	volatile uint32_t count; // total ever recorded, wraps into events
+	struct TraceEvent {
+		const char* label;
+		uint64_t at; // microseconds since Trace_init()
+		char type;
+	} events[TRACE_CAPACITY];
+} trace;
+
+void Trace_init(const char* name) {
+	snprintf(trace.name, sizeof(trace.name), "%s", name);
+	trace.start = getMicroseconds();
+	trace.count = 0;
+	atexit(Trace_dump);
+}
+
+static void Trace_push(const char* label, char type) {
+	if (!trace.start) return;
+	uint32_t i = __sync_fetch_and_add(&trace.count, 1) % TRACE_CAPACITY; // the directory loader traces too
+	struct TraceEvent* event = &trace.events[i];
+	event->label = label;
+	event->at = getMicroseconds() - trace.start;
+	event->type = type;
+}
+void Trace_begin(const char* label) {
+	Trace_push(label, TRACE_EVENT_BEGIN);
+}
+void Trace_end(const char* label) {
+	Trace_push(label, TRACE_EVENT_END);
+}
+void Trace_mark(const char* label) {
+	Trace_push(label, TRACE_EVENT_MARK);
+}
+
+void Trace_dump(void) {
+	if (!trace.start) return;
+	
+	mkdir(LOGS_PATH, 0755);
+	char path[MAX_PATH];
+	sprintf(path, "%s/%s.trace.txt", LOGS_PATH, trace.name);
+	FILE* file = fopen(path, "w");
+	if (!file) return;
+	
+	uint32_t count = trace.count;
+	uint32_t first = count>TRACE_CAPACITY ? count - TRACE_CAPACITY : 0;
+	if (first) fprintf(file, "# dropped %u oldest events\n", first);
+	fprintf(file, "# time (us) event duration (us)\n");
+	
+	for (uint32_t i=first; i<count; i++) {
+		struct TraceEvent* event = &trace.events[i % TRACE_CAPACITY];
+		if (event->type==TRACE_EVENT_END) {
+			// find the matching begin, nested scopes are closed first
+			int depth = 0;
+			for (uint32_t j=i; j-->first; ) {
+				struct TraceEvent* other = &trace.events[j % TRACE_CAPACITY];
+				if (other->label!=event->label && strcmp(other->label, event->label)) continue;
+				if (other->type==TRACE_EVENT_END) depth += 1;
+				else if (other->type==TRACE_EVENT_BEGIN && depth--==0) {
+					fprintf(file, "%10llu E %s %llu\n", (unsigned long long)event->at, event->label, (unsigned long long)(event->at - other->at));
+					break;
+				}
+			}
+			if (depth>=0) fprintf(file, "%10llu E %s ?\n", (unsigned long long)event->at, event->label); // begin was dropped
+		}
+		else {
+			fprintf(file, "%10llu %c %s\n", (unsigned long long)event->at, event->type, event->label);
+		}
+	}
+	fclose(file);
+	
+	trace.start = 0; // only once
+}
@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// startup tracing, compiled out unless built with -DTRACE
+// events go into a fixed ring buffer and are written to LOGS_PATH/<name>.trace.txt on exit
+
+#define TRACE_CAPACITY 1024
+
+void Trace_init(const char* name); // registers the dump with atexit()
+void Trace_begin(const char* label); // label must be a string literal (or otherwise outlive the process)
+void Trace_end(const char* label);
+void Trace_mark(const char* label); // a single point in time
+void Trace_dump(void);
+
+#ifdef TRACE
+static inline void Trace_endScope(const char** label) { Trace_end(*label); }
+#define TRACE_INIT(name) Trace_init(name)
+#define TRACE_BEGIN(label) Trace_begin(label)
+#define TRACE_END(label) Trace_end(label)
+#define TRACE_MARK(label) Trace_mark(label)
+#define TRACE_SCOPE(label) const char* _trace_scope __attribute__((cleanup(Trace_endScope))) = label; Trace_begin(label) // ends with the enclosing block
+#else
+#define TRACE_INIT(name)
+#define TRACE_BEGIN(label)
+#define TRACE_END(label)
+#define TRACE_MARK(label)
+#define TRACE_SCOPE(label)
+#endif
+
+#endif
@@ -31,6 +31,10 @@
 
 #include "fft/fft.c"
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 struct eq_data
 {
    fft_t *fft;
@@ -100,7 +104,20 @@ static void eq_process(void *data, struct dspfilter_output *output,
          for (c = 0; c < 2; c++)
          {
             fft_process_forward(eq->fft, eq->fftblock, eq->block + c, 2);
-            for (i = 0; i < 2 * eq->block_size; i++)
+            i = 0;
+#if defined(__ARM_NEON__)
+            /* Four bins at a time, vld2 splits real and imaginary parts. */
+            for (; i + 4 <= 2 * eq->block_size; i += 4)
+            {
+               float32x4x2_t a = vld2q_f32((const float*)(eq->fftblock + i));
+               float32x4x2_t b = vld2q_f32((const float*)(eq->filter + i));
+               float32x4x2_t r;
+               r.val[0] = vmlsq_f32(vmulq_f32(a.val[0], b.val[0]), a.val[1], b.val[1]);
+               r.val[1] = vmlaq_f32(vmulq_f32(a.val[1], b.val[0]), a.val[0], b.val[1]);
+               vst2q_f32((float*)(eq->fftblock + i), r);
+            }
+#endif
+            for (; i < 2 * eq->block_size; i++)
                eq->fftblock[i] = fft_complex_mul(eq->fftblock[i], eq->filter[i]);
             fft_process_inverse(eq->fft, out + c, eq->fftblock, 2);
          }
@@ -28,6 +28,10 @@
 #include <libretro_dspfilter.h>
 #include <string/stdstring.h>
 
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #define sqr(a) ((a) * (a))
 
 /* filter types */
@@ -91,6 +95,50 @@ static void iir_process(void *data, struct dspfilter_output *output,
    output->samples      = input->samples;
    output->frames       = input->frames;
 
+#if defined(__ARM_NEON__)
+   {
+      /* Left and right share the coefficients, run them in one vector. */
+      float32x2_t b0v = vdup_n_f32(b0);
+      float32x2_t b1v = vdup_n_f32(b1);
+      float32x2_t b2v = vdup_n_f32(b2);
+      float32x2_t a1v = vdup_n_f32(a1);
+      float32x2_t a2v = vdup_n_f32(a2);
+      float32x2_t inv_a0 = vdup_n_f32(1.0f / a0);
+
+      float32x2_t xn1 = vset_lane_f32(xn1_r, vdup_n_f32(xn1_l), 1);
+      float32x2_t xn2 = vset_lane_f32(xn2_r, vdup_n_f32(xn2_l), 1);
+      float32x2_t yn1 = vset_lane_f32(yn1_r, vdup_n_f32(yn1_l), 1);
+      float32x2_t yn2 = vset_lane_f32(yn2_r, vdup_n_f32(yn2_l), 1);
+
+      for (i = 0; i < input->frames; i++, out += 2)
+      {
+         float32x2_t in = vld1_f32(out);
+         float32x2_t y  = vmul_f32(b0v, in);
+
+         y   = vmla_f32(y, b1v, xn1);
+         y   = vmla_f32(y, b2v, xn2);
+         y   = vmls_f32(y, a1v, yn1);
+         y   = vmls_f32(y, a2v, yn2);
+         y   = vmul_f32(y, inv_a0);
+
+         xn2 = xn1;
+         xn1 = in;
+         yn2 = yn1;
+         yn1 = y;
+
+         vst1_f32(out, y);
+      }
+
+      xn1_l = vget_lane_f32(xn1, 0);
+      xn1_r = vget_lane_f32(xn1, 1);
+      xn2_l = vget_lane_f32(xn2, 0);
+      xn2_r = vget_lane_f32(xn2, 1);
+      yn1_l = vget_lane_f32(yn1, 0);
+      yn1_r = vget_lane_f32(yn1, 1);
+      yn2_l = vget_lane_f32(yn2, 0);
+      yn2_r = vget_lane_f32(yn2, 1);
+   }
+#else
    for (i = 0; i < input->frames; i++, out += 2)
    {
       float in_l = out[0];
@@ -112,6 +160,7 @@ static void iir_process(void *data, struct dspfilter_output *output,
       out[0]     = l;
       out[1]     = r;
    }
+#endif
 
    iir->l.xn1 = xn1_l;
    iir->l.xn2 = xn2_l;
@@ -20,6 +20,7 @@
 #include "utils.h"
 #include "api.h"
 #include "scaler_neon.h"
+#include "trace.h"
 
 ///////////////////////////////////////
 
@@ -33,15 +34,32 @@ enum {
 	SCALE_FULLSCREEN,
 };
 
+enum {
+	FRAMESKIP_OFF,
+	FRAMESKIP_AUTO,
+	FRAMESKIP_THRESHOLD,
+	FRAMESKIP_FIXED, // skip 1, 2 or 3 frames of every 2, 3 or 4
+};
+#define FRAMESKIP_AUTO_OCCUPANCY 25 // percent, the ring sits at 50 when on target
+
 // default frontend options
 static int screen_scaling = SCALE_ASPECT; // aspect
 static int show_scanlines = 0;
 static int optimize_text = 0;
 static int prevent_tearing = 1; // lenient
+static int threaded_present = 0;
 static int show_debug = 0;
 static int max_ff_speed = 3; // 4x
 static int fast_forward = 0;
+static int ff_audio = 0; // mute
 static int overclock = 1; // normal
+static int audio_resampler = 1; // linear
+static int audio_latency = 3; // 64ms
+static int audio_latency_min = 0; // ms, requested by the core
+static int audio_filter = 0; // off, uses the pak's default.dsp when on
+static int frameskip = 0; // off
+static int frameskip_threshold = 1; // 30%
+static int skip_video = 0; // the frame being run won't be drawn
 
 static struct Renderer {
 	int src_w;
@@ -54,6 +72,7 @@ static struct Renderer {
 	int dst_p;
 
 	scale_neon_t scaler;
+	scaleNN_cols_t cols; // for the scaleNN* scalers
 	const void* data;
 } renderer;
 
@@ -96,7 +115,7 @@ static struct Core {
 	void *(*get_memory_data)(unsigned id);
 	size_t (*get_memory_size)(unsigned id);
 	
-	// retro_audio_buffer_status_callback_t audio_buffer_status;
+	retro_audio_buffer_status_callback_t audio_buffer_status;
 } core;
 
 ///////////////////////////////////////
@@ -576,9 +595,16 @@ enum {
 	FE_OPT_SCANLINES,
 	FE_OPT_TEXT,
 	FE_OPT_TEARING,
+	FE_OPT_THREADED,
 	FE_OPT_OVERCLOCK,
 	FE_OPT_DEBUG,
 	FE_OPT_MAXFF,
+	FE_OPT_FF_AUDIO,
+	FE_OPT_RESAMPLER,
+	FE_OPT_LATENCY,
+	FE_OPT_FILTER,
+	FE_OPT_FRAMESKIP,
+	FE_OPT_FRAMESKIP_THRESHOLD,
 	FE_OPT_COUNT,
 };
 
@@ -715,6 +741,62 @@ static char* shortcut_labels[] = {
 	"MENU+R2",
 	NULL,
 };
+static char* ff_audio_labels[] = {
+	"Mute",
+	"Skip",
+	"Stretch",
+	NULL,
+};
+static char* resampler_labels[] = {
+	"Nearest",
+	"Linear",
+	"Cubic",
+	"Sinc Low",
+	"Sinc",
+	"Sinc High",
+	NULL,
+};
+static char* latency_values[] = {
+	"16",
+	"32",
+	"48",
+	"64",
+	"96",
+	"128",
+	"256",
+	NULL,
+};
+static char* latency_labels[] = {
+	"16ms",
+	"32ms",
+	"48ms",
+	"64ms",
+	"96ms",
+	"128ms",
+	"256ms",
+	NULL,
+};
+static char* frameskip_labels[] = {
+	"Off",
+	"Auto",
+	"Threshold",
+	"1",
+	"2",
+	"3",
+	NULL,
+};
+static char* frameskip_threshold_values[] = {
+	"20",
+	"30",
+	"40",
+	NULL,
+};
+static char* frameskip_threshold_labels[] = {
+	"20%",
+	"30%",
+	"40%",
+	NULL,
+};
 static char* overclock_labels[] = {
 	"Powersave",
 	"Normal",
@@ -781,6 +863,16 @@ static struct Config {
 				.values = tearing_labels,
 				.labels = tearing_labels,
 			},
+			[FE_OPT_THREADED] = {
+				.key	= "minarch_threaded_present",
+				.name	= "Threaded Present",
+				.desc	= "Wait for vsync on a separate thread so the\ncore can start on the next frame right away.",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
 			[FE_OPT_OVERCLOCK] = {
 				.key	= "minarch_cpu_speed",
 				.name	= "CPU Speed",
@@ -794,7 +886,7 @@ static struct Config {
 			[FE_OPT_DEBUG] = {
 				.key	= "minarch_debug_hud",
 				.name	= "Debug HUD",
-				.desc	= "Show frames per second, cpu load,\nresolution, and scaler information.",
+				.desc	= "Show frames per second, cpu load, resolution,\nscaler, and audio buffer information.",
 				.default_value = 0,
 				.value = 0,
 				.count = 2,
@@ -811,6 +903,66 @@ static struct Config {
 				.values = max_ff_labels,
 				.labels = max_ff_labels,
 			},
+			[FE_OPT_FF_AUDIO] = {
+				.key	= "minarch_ff_audio",
+				.name	= "FF Audio",
+				.desc	= "Keep sound while fast forwarding. Skip jumps\nahead and crossfades, Stretch is smoother.",
+				.default_value = 0,
+				.value = 0,
+				.count = 3,
+				.values = ff_audio_labels,
+				.labels = ff_audio_labels,
+			},
+			[FE_OPT_RESAMPLER] = {
+				.key	= "minarch_audio_resampler",
+				.name	= "Audio Resampler",
+				.desc	= "How audio is converted when the core's sample rate\ndoesn't match the device. Sinc sounds best but costs more CPU.",
+				.default_value = 1, // linear
+				.value = 1, // linear
+				.count = 6,
+				.values = resampler_labels,
+				.labels = resampler_labels,
+			},
+			[FE_OPT_LATENCY] = {
+				.key	= "minarch_audio_latency",
+				.name	= "Audio Latency",
+				.desc	= "Lower is more responsive but may crackle\nif the core can't keep up.",
+				.default_value = 3, // 64ms
+				.value = 3, // 64ms
+				.count = 7,
+				.values = latency_values,
+				.labels = latency_labels,
+			},
+			[FE_OPT_FILTER] = {
+				.key	= "minarch_audio_filter",
+				.name	= "Audio Filter",
+				.desc	= "Apply the pak's default.dsp filter preset\n(eg. a lowpass to tame the speaker).",
+				.default_value = 0,
+				.value = 0,
+				.count = 2,
+				.values = onoff_labels,
+				.labels = onoff_labels,
+			},
+			[FE_OPT_FRAMESKIP] = {
+				.key	= "minarch_frameskip",
+				.name	= "Frameskip",
+				.desc	= "Skip drawing frames to keep audio at full speed. Auto skips\nwhen falling behind, Threshold when audio drops below it.\nSet the core's own frameskip option to auto if it has one.",
+				.default_value = FRAMESKIP_OFF,
+				.value = FRAMESKIP_OFF,
+				.count = 6,
+				.values = frameskip_labels,
+				.labels = frameskip_labels,
+			},
+			[FE_OPT_FRAMESKIP_THRESHOLD] = {
+				.key	= "minarch_frameskip_threshold",
+				.name	= "Frameskip Threshold",
+				.desc	= "Audio buffer occupancy below which\nThreshold frameskip starts skipping.",
+				.default_value = 1, // 30%
+				.value = 1, // 30%
+				.count = 3,
+				.values = frameskip_threshold_values,
+				.labels = frameskip_threshold_labels,
+			},
 			[FE_OPT_COUNT] = {NULL}
 		}
 	},
@@ -860,15 +1012,48 @@ static void setOverclock(int i) {
 		case 2: POW_setCPUSpeed(CPU_SPEED_PERFORMANCE); break;
 	}
 }
+static void setResampler(int i) {
+	audio_resampler = i;
+	if (i<=SND_RESAMPLER_CUBIC) SND_setResampler(i, 0);
+	else SND_setResampler(SND_RESAMPLER_SINC, i - SND_RESAMPLER_CUBIC + 1); // lower, normal or higher quality
+}
+static void applyLatency(void) {
+	int ms = atoi(latency_values[audio_latency]);
+	if (ms<audio_latency_min) ms = audio_latency_min;
+	SND_setLatency(ms);
+}
+static void setLatency(int i) {
+	audio_latency = i;
+	applyLatency();
+}
+static void setFilter(int i) {
+	audio_filter = i;
+	
+	char dsp_path[MAX_PATH];
+	getEmuPath((char *)core.tag, dsp_path);
+	char* tmp = strrchr(dsp_path, '/');
+	strcpy(tmp,"/default.dsp");
+	if (!exists(dsp_path)) sprintf(dsp_path, "%s/Emus/%s.pak/default.dsp", PAKS_PATH, core.tag); // a user pak can use the system pak's preset
+	
+	if (audio_filter && exists(dsp_path)) SND_setFilter(dsp_path);
+	else SND_setFilter(NULL);
+}
 static void Config_syncFrontend(int i, int value) {
 	switch (i) {
 		case FE_OPT_SCALING:	screen_scaling 	= value; renderer.src_w = 0; break;
 		case FE_OPT_SCANLINES:	show_scanlines 	= value; renderer.src_w = 0; break;
 		case FE_OPT_TEXT:		optimize_text 	= value; renderer.src_w = 0; break;
 		case FE_OPT_TEARING:	prevent_tearing = value; break;
+		case FE_OPT_THREADED:	threaded_present = value; break;
 		case FE_OPT_OVERCLOCK:	overclock		= value; break;
 		case FE_OPT_DEBUG:		show_debug 		= value; break;
 		case FE_OPT_MAXFF:		max_ff_speed 	= value; break;
+		case FE_OPT_FF_AUDIO:	ff_audio		= value; break;
+		case FE_OPT_RESAMPLER:	setResampler(value); break;
+		case FE_OPT_LATENCY:	setLatency(value); break;
+		case FE_OPT_FILTER:		setFilter(value); break;
+		case FE_OPT_FRAMESKIP:	frameskip		= value; break;
+		case FE_OPT_FRAMESKIP_THRESHOLD: frameskip_threshold = value; break;
 	}
 	Option* option = &config.frontend.options[i];
 	option->value = value;
@@ -1625,6 +1810,11 @@ static bool environment_callback(unsigned cmd, void *data) { // copied from pico
 		break;
 	}
 	// RETRO_ENVIRONMENT_GET_LANGUAGE 39
+	case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE: { /* 47 | EXPERIMENTAL */
+		int *out = (int *)data;
+		if (out) *out = (skip_video ? 0 : 1) | 2; // bit 0 video, bit 1 audio (always)
+		break;
+	}
 	case RETRO_ENVIRONMENT_GET_INPUT_BITMASKS: { /* 51 */
 		bool *out = (bool *)data;
 		if (out)
@@ -1676,34 +1866,22 @@ static bool environment_callback(unsigned cmd, void *data) { // copied from pico
 		break;
 	}
 	// TODO: RETRO_ENVIRONMENT_GET_MESSAGE_INTERFACE_VERSION 59
-	// TODO: used by mgba, (but only during frameskip?)
-	// case RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK: { /* 62 */
-	// 	LOG_info("RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK\n");
-	// 	const struct retro_audio_buffer_status_callback *cb = (const struct retro_audio_buffer_status_callback *)data;
-	// 	if (cb) {
-	// 		LOG_info("has audo_buffer_status callback\n");
-	// 		core.audio_buffer_status = cb->callback;
-	// 	} else {
-	// 		LOG_info("no audo_buffer_status callback\n");
-	// 		core.audio_buffer_status = NULL;
-	// 	}
-	// 	break;
-	// }
-	// TODO: used by mgba, (but only during frameskip?)
-	// case RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY: { /* 63 */
-	// 	LOG_info("RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY\n");
-	//
-	// 	const unsigned *latency_ms = (const unsigned *)data;
-	// 	if (latency_ms) {
-	// 		unsigned frames = *latency_ms * core.fps / 1000;
-	// 		if (frames < 30)
-	// 			// audio_buffer_size_override = frames;
-	// 			LOG_info("audio_buffer_size_override = %i (unused?)\n", frames);
-	// 		else
-	// 			LOG_info("Audio buffer change out of range (%d), ignored\n", frames);
-	// 	}
-	// 	break;
-	// }
+	// used by mgba, snes9x2005, pcsx_rearmed, gpsp for their own frameskip
+	case RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK: { /* 62 */
+		const struct retro_audio_buffer_status_callback *cb = (const struct retro_audio_buffer_status_callback *)data;
+		core.audio_buffer_status = cb ? cb->callback : NULL;
+		LOG_info("RETRO_ENVIRONMENT_SET_AUDIO_BUFFER_STATUS_CALLBACK: %s\n", core.audio_buffer_status ? "set" : "cleared");
+		break;
+	}
+	case RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY: { /* 63 */
+		const unsigned *latency_ms = (const unsigned *)data;
+		if (latency_ms) {
+			audio_latency_min = MIN(*latency_ms, 512); // 0 restores the user's
+			LOG_info("RETRO_ENVIRONMENT_SET_MINIMUM_AUDIO_LATENCY: %i\n", audio_latency_min);
+			applyLatency();
+		}
+		break;
+	}
 
 	// TODO: RETRO_ENVIRONMENT_SET_FASTFORWARDING_OVERRIDE 64
 	case RETRO_ENVIRONMENT_SET_CONTENT_INFO_OVERRIDE: { /* 65 */
@@ -1781,7 +1959,7 @@ static void MSG_init(void) {
 	char* c;
 	int i = 0;
 	while ((c = chars[i])) {
-		digit = TTF_RenderUTF8_Blended(font.tiny, c, COLOR_WHITE);
+		digit = GFX_renderText(font.tiny, c, COLOR_WHITE);
 		SDL_BlitSurface(digit, NULL, digits, &(SDL_Rect){ (i * DIGIT_WIDTH) + (DIGIT_WIDTH - digit->w)/2, (DIGIT_HEIGHT - digit->h)/2});
 		SDL_FreeSurface(digit);
 		i += 1;
@@ -1836,21 +2014,24 @@ static int MSG_blitDouble(double num, int x, int y) {
 	x = MSG_blitChar(n,x,y);
 	return x;
 }
+static int MSG_blitRatio(double num, int x, int y) { // three decimals, eg. 1.003
+	int r = num * 1000 + 0.5;
+	
+	x = MSG_blitInt(r / 1000, x,y);
+	x = MSG_blitChar(DIGIT_DOT,x,y);
+	
+	r %= 1000;
+	x = MSG_blitChar(r / 100,x,y);
+	x = MSG_blitChar(r / 10 % 10,x,y);
+	x = MSG_blitChar(r % 10,x,y);
+	return x;
+}
 static void MSG_quit(void) {
 	SDL_FreeSurface(digits);
 }
 
 ///////////////////////////////
 
-// from gambatte-dms
-//from RGB565
-#define cR(A) (((A) & 0xf800) >> 11)
-#define cG(A) (((A) & 0x7e0) >> 5)
-#define cB(A) ((A) & 0x1f)
-//to RGB565
-#define Weight2_3(A, B)  (((((cR(A) << 1) + (cR(B) * 3)) / 5) & 0x1f) << 11 | ((((cG(A) << 1) + (cG(B) * 3)) / 5) & 0x3f) << 5 | ((((cB(A) << 1) + (cB(B) * 3)) / 5) & 0x1f))
-#define Weight3_2(A, B)  (((((cR(B) << 1) + (cR(A) * 3)) / 5) & 0x1f) << 11 | ((((cG(B) << 1) + (cG(A) * 3)) / 5) & 0x3f) << 5 | ((((cB(B) << 1) + (cB(A) * 3)) / 5) & 0x1f))
-
 static int cpu_ticks = 0;
 static int fps_ticks = 0;
 static int use_ticks = 0;
@@ -1860,22 +2041,6 @@ static double use_double = 0;
 static uint32_t sec_start = 0;
 
 
-//from RGB565
-#define cR(A) (((A) & 0xf800) >> 11)
-#define cG(A) (((A) & 0x7e0) >> 5)
-#define cB(A) ((A) & 0x1f)
-//to RGB565
-#define Weight1_1(A, B)  ((((cR(A) + cR(B)) >> 1) & 0x1f) << 11 | (((cG(A) + cG(B)) >> 1) & 0x3f) << 5 | (((cB(A) + cB(B)) >> 1) & 0x1f))
-#define Weight1_2(A, B)  ((((cR(A) + (cR(B) << 1)) / 3) & 0x1f) << 11 | (((cG(A) + (cG(B) << 1)) / 3) & 0x3f) << 5 | (((cB(A) + (cB(B) << 1)) / 3) & 0x1f))
-#define Weight2_1(A, B)  ((((cR(B) + (cR(A) << 1)) / 3) & 0x1f) << 11 | (((cG(B) + (cG(A) << 1)) / 3) & 0x3f) << 5 | (((cB(B) + (cB(A) << 1)) / 3) & 0x1f))
-#define Weight1_3(A, B)  ((((cR(A) + (cR(B) * 3)) >> 2) & 0x1f) << 11 | (((cG(A) + (cG(B) * 3)) >> 2) & 0x3f) << 5 | (((cB(A) + (cB(B) * 3)) >> 2) & 0x1f))
-#define Weight3_1(A, B)  ((((cR(B) + (cR(A) * 3)) >> 2) & 0x1f) << 11 | (((cG(B) + (cG(A) * 3)) >> 2) & 0x3f) << 5 | (((cB(B) + (cB(A) * 3)) >> 2) & 0x1f))
-#define Weight1_4(A, B)  ((((cR(A) + (cR(B) << 2)) / 5) & 0x1f) << 11 | (((cG(A) + (cG(B) << 2)) / 5) & 0x3f) << 5 | (((cB(A) + (cB(B) << 2)) / 5) & 0x1f))
-#define Weight4_1(A, B)  ((((cR(B) + (cR(A) << 2)) / 5) & 0x1f) << 11 | (((cG(B) + (cG(A) << 2)) / 5) & 0x3f) << 5 | (((cB(B) + (cB(A) << 2)) / 5) & 0x1f))
-#define Weight2_3(A, B)  (((((cR(A) << 1) + (cR(B) * 3)) / 5) & 0x1f) << 11 | ((((cG(A) << 1) + (cG(B) * 3)) / 5) & 0x3f) << 5 | ((((cB(A) << 1) + (cB(B) * 3)) / 5) & 0x1f))
-#define Weight3_2(A, B)  (((((cR(B) << 1) + (cR(A) * 3)) / 5) & 0x1f) << 11 | ((((cG(B) << 1) + (cG(A) * 3)) / 5) & 0x3f) << 5 | ((((cB(B) << 1) + (cB(A) * 3)) / 5) & 0x1f))
-#define Weight1_1_1_1(A, B, C, D)  ((((cR(A) + cR(B) + cR(C) + cR(D)) >> 2) & 0x1f) << 11 | (((cG(A) + cG(B) + cG(C) + cG(D)) >> 2) & 0x3f) << 5 | (((cB(A) + cB(B) + cB(C) + cB(D)) >> 2) & 0x1f))
-
 static void scaleNull(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {}
 static void scale1x(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
 	// pitch of src image not src buffer!
@@ -1895,31 +2060,6 @@ static void scale1x(void* __restrict src, void* __restrict dst, uint32_t w, uint
 		src_row += src_stride;
 	}
 	
-}
-static void scale1x_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	// pitch of src image not src buffer!
-	// eg. gb has a 160 pixel wide image but 
-	// gambatte uses a 256 pixel wide buffer
-	// (only matters when using memcpy) 
-	int src_pitch = w * FIXED_BPP; 
-	int src_stride = 2 * pitch / FIXED_BPP;
-	int dst_stride = 2 * dst_pitch / FIXED_BPP;
-	int cpy_pitch = MIN(src_pitch, dst_pitch);
-	
-	uint16_t k = 0x0000;
-	uint16_t* restrict src_row = (uint16_t*)src;
-	uint16_t* restrict dst_row = (uint16_t*)dst;
-	for (int y=0; y<h; y+=2) {
-		memcpy(dst_row, src_row, cpy_pitch);
-		dst_row += dst_stride;
-		src_row += src_stride;
-		
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t s = *(src_row + x);
-			*(dst_row + x) = Weight3_1(s, k);
-		}
-	}
-	
 }
 static void scale2x(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
 	int screen_w = screen->w;
@@ -1942,71 +2082,6 @@ static void scale2x(void* __restrict src, void* __restrict dst, uint32_t w, uint
 		}
 	}
 }
-static void scale2x_lcd(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 2;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t s = *src_row;
-            uint16_t r = (s & 0b1111100000000000);
-            uint16_t g = (s & 0b0000011111100000);
-            uint16_t b = (s & 0b0000000000011111);
-			
-			*(dst_row                       ) = r;
-			*(dst_row + 1                   ) = b;
-			
-			*(dst_row + screen_w * 1    ) = g;
-			*(dst_row + screen_w * 1 + 1) = k;
-			
-			src_row += 1;
-			dst_row += 2;
-		}
-	}
-}
-static void scale2x_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 2;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t c1 = *src_row;
-			uint16_t c2 = Weight3_2( c1, k);
-			
-			*(dst_row     ) = c1;
-			*(dst_row + 1 ) = c1;
-			
-			*(dst_row + screen_w    ) = c2;
-			*(dst_row + screen_w + 1) = c2;
-			
-			src_row += 1;
-			dst_row += 2;
-		}
-	}
-}
-static void scale2x_grid(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 2;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t c1 = *src_row;
-			uint16_t c2 = Weight3_1( c1, k);
-			
-			*(dst_row     ) = c2;
-			*(dst_row + 1 ) = c2;
-			
-			*(dst_row + screen_w    ) = c2;
-			*(dst_row + screen_w + 1) = c1;
-			
-			src_row += 1;
-			dst_row += 2;
-		}
-	}
-}
 static void scale3x(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
 	int screen_w = screen->w;
 	int row3 = screen_w * 2;
@@ -2036,132 +2111,6 @@ static void scale3x(void* __restrict src, void* __restrict dst, uint32_t w, uint
 		}
 	}
 }
-static void scale3x_lcd(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	int row3 = screen_w * 2;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 3;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t s = *src_row;
-            uint16_t r = (s & 0b1111100000000000);
-            uint16_t g = (s & 0b0000011111100000);
-            uint16_t b = (s & 0b0000000000011111);
-			
-			// row 1
-			*(dst_row    ) = k;
-			*(dst_row + 1) = g;
-			*(dst_row + 2) = k;
-			
-			// row 2
-			*(dst_row + screen_w    ) = r;
-			*(dst_row + screen_w + 1) = g;
-			*(dst_row + screen_w + 2) = b;
-
-			// row 3
-			*(dst_row + row3    ) = r;
-			*(dst_row + row3 + 1) = k;
-			*(dst_row + row3 + 2) = b;
-
-			src_row += 1;
-			dst_row += 3;
-		}
-	}
-}
-static void scale3x_dmg(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t g = 0xffff;
-	int row3 = screen_w * 2;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 3;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t a = *src_row;
-            uint16_t b = Weight3_2( a, g);
-            uint16_t c = Weight2_3( a, g);
-			
-			// row 1
-			*(dst_row    ) = b;
-			*(dst_row + 1) = a;
-			*(dst_row + 2) = a;
-			
-			// row 2
-			*(dst_row + screen_w    ) = b;
-			*(dst_row + screen_w + 1) = a;
-			*(dst_row + screen_w + 2) = a;
-
-			// row 3
-			*(dst_row + row3    ) = c;
-			*(dst_row + row3 + 1) = b;
-			*(dst_row + row3 + 2) = b;
-
-			src_row += 1;
-			dst_row += 3;
-		}
-	}
-}
-static void scale3x_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 3;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t c1 = *src_row;
-			uint16_t c2 = Weight3_2( c1, k);
-			
-			// row 1
-			*(dst_row                       ) = c2;
-			*(dst_row                    + 1) = c2;
-			*(dst_row                    + 2) = c2;
-
-			// row 2
-			*(dst_row + screen_w * 1    ) = c1;
-			*(dst_row + screen_w * 1 + 1) = c1;
-			*(dst_row + screen_w * 1 + 2) = c1;
-
-			// row 3
-			*(dst_row + screen_w * 2    ) = c1;
-			*(dst_row + screen_w * 2 + 1) = c1;
-			*(dst_row + screen_w * 2 + 2) = c1;
-
-			src_row += 1;
-			dst_row += 3;
-		}
-	}
-}
-static void scale3x_grid(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 3;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t c1 = *src_row;
-			uint16_t c2 = Weight3_2( c1, k);
-			uint16_t c3 = Weight2_3( c1, k);
-			
-			// row 1
-			*(dst_row                       ) = c2;
-			*(dst_row                    + 1) = c1;
-			*(dst_row                    + 2) = c1;
-
-			// row 2
-			*(dst_row + screen_w * 1    ) = c2;
-			*(dst_row + screen_w * 1 + 1) = c1;
-			*(dst_row + screen_w * 1 + 2) = c1;
-
-			// row 3
-			*(dst_row + screen_w * 2    ) = c3;
-			*(dst_row + screen_w * 2 + 1) = c2;
-			*(dst_row + screen_w * 2 + 2) = c2;
-
-			src_row += 1;
-			dst_row += 3;
-		}
-	}
-}
 static void scale4x(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
 	int screen_w = screen->w;
 	int row3 = screen_w * 2;
@@ -2201,242 +2150,19 @@ static void scale4x(void* __restrict src, void* __restrict dst, uint32_t w, uint
 		}
 	}
 }
-static void scale4x_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int screen_w = screen->w;
-	int row3 = screen_w * 2;
-	int row4 = screen_w * 3;
-	uint16_t k = 0x0000;
-	for (unsigned y = 0; y < h; y++) {
-		uint16_t* restrict src_row = (void*)src + y * pitch;
-		uint16_t* restrict dst_row = (void*)dst + y * dst_pitch * 4;
-		for (unsigned x = 0; x < w; x++) {
-			uint16_t c1 = *src_row;
-			uint16_t c2 = Weight3_2( c1, k);
-			
-			// row 1
-			*(dst_row    ) = c1;
-			*(dst_row + 1) = c1;
-			*(dst_row + 2) = c1;
-			*(dst_row + 3) = c1;
-			
-			// row 2
-			*(dst_row + screen_w    ) = c2;
-			*(dst_row + screen_w + 1) = c2;
-			*(dst_row + screen_w + 2) = c2;
-			*(dst_row + screen_w + 3) = c2;
-
-			// row 3
-			*(dst_row + row3    ) = c1;
-			*(dst_row + row3 + 1) = c1;
-			*(dst_row + row3 + 2) = c1;
-			*(dst_row + row3 + 3) = c1;
-
-			// row 4
-			*(dst_row + row4    ) = c2;
-			*(dst_row + row4 + 1) = c2;
-			*(dst_row + row4 + 2) = c2;
-			*(dst_row + row4 + 3) = c2;
-
-			src_row += 1;
-			dst_row += 4;
-		}
-	}
-}
 // TODO: NN versions of scanline need updating to use blended scanlines (or maybe not for performance?) 
+// column lookups are built once in selectScaler_PAR(), see scaleNN_cols_n16()
 static void scaleNN(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int dy = -renderer.dst_h;
-	unsigned lines = h;
-	bool copy = false;
-	size_t cpy_w = renderer.dst_w * FIXED_BPP;
-
-	while (lines) {
-		int dx = -renderer.dst_w;
-		const uint16_t *psrc16 = src;
-		uint16_t *pdst16 = dst;
-
-		if (copy) {
-			copy = false;
-			memcpy(dst, dst - dst_pitch, cpy_w);
-			dst += dst_pitch;
-			dy += h;
-		} else if (dy < 0) {
-			int col = w;
-			while(col--) {
-				while (dx < 0) {
-					*pdst16++ = *psrc16;
-					dx += w;
-				}
-
-				dx -= renderer.dst_w;
-				psrc16++;
-			}
-
-			dst += dst_pitch;
-			dy += h;
-		}
-
-		if (dy >= 0) {
-			dy -= renderer.dst_h;
-			src += pitch;
-			lines--;
-		} else {
-			copy = true;
-		}
-	}
+	scaleNN_n16(src,dst,h,pitch,renderer.dst_h,dst_pitch,&renderer.cols,0,0);
 }
 static void scaleNN_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int dy = -renderer.dst_h;
-	unsigned lines = h;
-	int row = 0;
-	
-	while (lines) {
-		int dx = -renderer.dst_w;
-		const uint16_t *psrc16 = src;
-		uint16_t *pdst16 = dst;
-		
-		if (row%2==0) {
-			int col = w;
-			while(col--) {
-				while (dx < 0) {
-					*pdst16 = *(pdst16 + dst_pitch) = *psrc16;
-					pdst16 += 1;
-					dx += w;
-				}
-
-				dx -= renderer.dst_w;
-				psrc16++;
-			}
-		}
-
-		dst += dst_pitch;
-		dy += h;
-				
-		if (dy >= 0) {
-			dy -= renderer.dst_h;
-			src += pitch;
-			lines--;
-		}
-		row += 1;
-	}
+	scaleNN_n16(src,dst,h,pitch,renderer.dst_h,dst_pitch,&renderer.cols,0,1);
 }
 static void scaleNN_text(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int dy = -renderer.dst_h;
-	unsigned lines = h;
-	bool copy = false;
-
-	size_t cpy_w = renderer.dst_w * FIXED_BPP;
-	int screen_p = screen->pitch;
-		
-	int safe = w - 1; // don't look behind when there's nothing to see
-	uint16_t l1,l2;
-	while (lines) {
-		int dx = -renderer.dst_w;
-		const uint16_t *psrc16 = src;
-		uint16_t *pdst16 = dst;
-		l1 = l2 = 0x0;
-		
-		if (copy) {
-			copy = false;
-			memcpy(dst, dst - screen_p, cpy_w);
-			dst += screen_p;
-			dy += h;
-		} else if (dy < 0) {
-			int col = w;
-			while(col--) {
-				int d = 0;
-				if (col<safe && l1!=l2) {
-					// https://stackoverflow.com/a/71086522/145965
-					uint16_t r = (l1 >> 10) & 0x3E;
-					uint16_t g = (l1 >> 5) & 0x3F;
-					uint16_t b = (l1 << 1) & 0x3E;
-					uint16_t luma = (r * 218) + (g * 732) + (b * 74);
-					luma = (luma >> 10) + ((luma >> 9) & 1); // 0-63
-					d = luma > 24;
-				}
-
-				uint16_t s = *psrc16;
-				
-				while (dx < 0) {
-					*pdst16++ = d ? l1 : s;
-					dx += w;
-
-					l2 = l1;
-					l1 = s;
-					d = 0;
-				}
-
-				dx -= renderer.dst_w;
-				psrc16++;
-			}
-
-			dst += screen_p;
-			dy += h;
-		}
-
-		if (dy >= 0) {
-			dy -= renderer.dst_h;
-			src += pitch;
-			lines--;
-		} else {
-			copy = true;
-		}
-	}
+	scaleNN_n16(src,dst,h,pitch,renderer.dst_h,dst_pitch,&renderer.cols,1,0);
 }
 static void scaleNN_text_scanline(void* __restrict src, void* __restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_pitch) {
-	int dy = -renderer.dst_h;
-	unsigned lines = h;
-
-	int row = 0;
-	int safe = w - 1; // don't look behind when there's nothing to see
-	uint16_t l1,l2;
-	while (lines) {
-		int dx = -renderer.dst_w;
-		const uint16_t *psrc16 = src;
-		uint16_t *pdst16 = dst;
-		l1 = l2 = 0x0;
-		
-		if (row%2==0) {
-			int col = w;
-			while(col--) {
-				int d = 0;
-				if (col<safe && l1!=l2) {
-					// https://stackoverflow.com/a/71086522/145965
-					uint16_t r = (l1 >> 10) & 0x3E;
-					uint16_t g = (l1 >> 5) & 0x3F;
-					uint16_t b = (l1 << 1) & 0x3E;
-					uint16_t luma = (r * 218) + (g * 732) + (b * 74);
-					luma = (luma >> 10) + ((luma >> 9) & 1); // 0-63
-					d = luma > 24;
-				}
-
-				uint16_t s = *psrc16;
-				
-				while (dx < 0) {
-					*pdst16 = *(pdst16 + dst_pitch) = d ? l1 : s;
-					pdst16 += 1;
-					
-					dx += w;
-
-					l2 = l1;
-					l1 = s;
-					d = 0;
-				}
-
-				dx -= renderer.dst_w;
-				psrc16 += 1;
-			}
-		}
-
-		dst += dst_pitch;
-		dy += h;
-				
-		if (dy >= 0) {
-			dy -= renderer.dst_h;
-			src += pitch;
-			lines--;
-		}
-		row += 1;
-	}
+	scaleNN_n16(src,dst,h,pitch,renderer.dst_h,dst_pitch,&renderer.cols,1,1);
 }
 
 static SDL_Surface* scaler_surface;
@@ -2550,6 +2276,7 @@ static void selectScaler_PAR(int width, int height, int pitch) {
 	int ox = (device_width - renderer.dst_w) / 2;
 	int oy = (device_height - renderer.dst_h) / 2;
 	renderer.dst_offset = (oy * device_pitch) + (ox * FIXED_BPP);
+	scaleNN_cols_n16(&renderer.cols, width, renderer.dst_w);
 
 	if (use_nearest) 
 		if (show_scanlines) renderer.scaler = optimize_text ? scaleNN_text_scanline : scaleNN_scanline;
@@ -2560,10 +2287,10 @@ static void selectScaler_PAR(int width, int height, int pitch) {
 			switch (scale) {
 				case 6: 	renderer.scaler = scaleNN_scanline; break;
 				case 5: 	renderer.scaler = scaleNN_scanline; break;
-				case 4: 	renderer.scaler = scale4x_scanline; break;
-				case 3: 	renderer.scaler = scale3x_grid; break;
-				case 2: 	renderer.scaler = scale2x_scanline; break;
-				default:	renderer.scaler = scale1x_scanline; break;
+				case 4: 	renderer.scaler = scale4x_scanline_n16; break;
+				case 3: 	renderer.scaler = scale3x_grid_n16; break;
+				case 2: 	renderer.scaler = scale2x_scanline_n16; break;
+				default:	renderer.scaler = scale1x_scanline_n16; break;
 			}
 		}
 		else {
@@ -2578,12 +2305,12 @@ static void selectScaler_PAR(int width, int height, int pitch) {
 				// my lesser scalers :sweat_smile:
 				// case 4: 	renderer.scaler = scale4x; break;
 				// case 3: 	renderer.scaler = scale3x; break;
-				// case 3: 	renderer.scaler = scale3x_dmg; break;
-				// case 3: 	renderer.scaler = scale3x_lcd; break;
-				// case 3: 	renderer.scaler = scale3x_scanline; break;
+				// case 3: 	renderer.scaler = scale3x_dmg_n16; break;
+				// case 3: 	renderer.scaler = scale3x_lcd_n16; break;
+				// case 3: 	renderer.scaler = scale3x_scanline_n16; break;
 				// case 2: 	renderer.scaler = scale2x; break;
-				// case 2: 	renderer.scaler = scale2x_lcd; break;
-				// case 2: 	renderer.scaler = scale2x_scanline; break;
+				// case 2: 	renderer.scaler = scale2x_lcd_n16; break;
+				// case 2: 	renderer.scaler = scale2x_scanline_n16; break;
 				// default:	renderer.scaler = scale1x; break;
 			}
 		}
@@ -2592,7 +2319,7 @@ static void selectScaler_PAR(int width, int height, int pitch) {
 	
 	// DEBUG HUD
 	if (scaler_surface) SDL_FreeSurface(scaler_surface);
-	scaler_surface = TTF_RenderUTF8_Blended(font.tiny, scaler_name, COLOR_WHITE);
+	scaler_surface = GFX_renderText(font.tiny, scaler_name, COLOR_WHITE);
 	
 	screen = GFX_resize(device_width,device_height, device_pitch);
 }
@@ -2615,7 +2342,8 @@ static void selectScaler_AR(int width, int height, int pitch) {
 	// reduce scale if we don't have enough memory to accomodate it
 	// scaled width and height can't be greater than our fixed page width or height
 	// TODO: some resolutions are getting through here unadjusted? oh maybe because of aspect ratio adjustments below? revisit
-	while (src_w * scale * FIXED_BPP * src_h * scale > PAGE_SIZE || src_w * scale > PAGE_WIDTH || src_h * scale > PAGE_HEIGHT) {
+	uint32_t page_limit = GFX_getPageLimit();
+	while (scale>1 && (src_w * scale * FIXED_BPP * src_h * scale > page_limit || src_w * scale > PAGE_WIDTH || src_h * scale > PAGE_HEIGHT)) {
 		scale -= 1;
 	}
 	
@@ -2716,9 +2444,22 @@ static void selectScaler_AR(int width, int height, int pitch) {
 	
 	// DEBUG HUD
 	if (scaler_surface) SDL_FreeSurface(scaler_surface);
-	scaler_surface = TTF_RenderUTF8_Blended(font.tiny, scaler_name, COLOR_WHITE);
+	scaler_surface = GFX_renderText(font.tiny, scaler_name, COLOR_WHITE);
 	
-	screen = GFX_resize(target_w,target_h, target_pitch);
+	SDL_Surface* resized = GFX_resize(target_w,target_h, target_pitch);
+	if (resized) screen = resized;
+	else {
+		// PMEM couldn't fit larger pages, GFX_getPageLimit() now returns what's
+		// held so try a scale that fits that, then PAR which always fits
+		static int retrying = 0;
+		LOG_warn("%ix%i doesn't fit the pages, falling back\n", target_w,target_h);
+		if (retrying) selectScaler_PAR(width,height,pitch);
+		else {
+			retrying = 1;
+			selectScaler_AR(width,height,pitch);
+			retrying = 0;
+		}
+	}
 }
 static void video_refresh_callback(const void *data, unsigned width, unsigned height, size_t pitch) {
 	static uint32_t last_flip_time = 0;
@@ -2727,6 +2468,7 @@ static void video_refresh_callback(const void *data, unsigned width, unsigned he
 	// 14 will let GB hit 10x but NES and SNES will drop to 1.5x at 30fps (not sure why)
 	// but 10 hurts PS...
 	if (fast_forward && SDL_GetTicks()-last_flip_time<10) return;
+	if (skip_video) return; // frontend frameskip, see updateFrameskip()
 	
 	// FFVII menus 
 	// 16: 30/200
@@ -2739,6 +2481,7 @@ static void video_refresh_callback(const void *data, unsigned width, unsigned he
 	// eg. PS@10 60/240
 	
 	if (!data) return;
+	GFX_waitPage(); // the present thread may still be showing the backbuffer
 	renderer.data = data; // this pointer isn't guaranteed to hang around but this approach worked on the Mini
 
 	fps_ticks += 1;
@@ -2780,6 +2523,10 @@ static void video_refresh_callback(const void *data, unsigned width, unsigned he
 		x = MSG_blitInt(POW_readBatteryStatus(), x,y);
 		x = MSG_blitChar(DIGIT_PERCENT,x,y);
 		
+		// MB of ION memory reserved for pages
+		x = MSG_blitChar(DIGIT_SPACE,x,y);
+		x = MSG_blitDouble(GFX_getReserved() / (1024.0 * 1024.0), x,y);
+		
 		if (x>bottom_width) bottom_width = x; // keep the largest width because triple buffer
 		
 		x = 0;
@@ -2806,6 +2553,19 @@ static void video_refresh_callback(const void *data, unsigned width, unsigned he
 			x += DIGIT_WIDTH * 3;
 		}
 		
+		// audio ring fill and rate control
+		x = MSG_blitChar(DIGIT_SPACE,x,y);
+		x = MSG_blitInt(SND_getBufferFill(),x,y);
+		x = MSG_blitChar(DIGIT_PERCENT,x,y);
+		x = MSG_blitChar(DIGIT_SPACE,x,y);
+		x = MSG_blitRatio(SND_getRateAdjust(),x,y);
+		
+		// underruns/overruns
+		x = MSG_blitChar(DIGIT_SPACE,x,y);
+		x = MSG_blitInt(MIN(SND_getUnderruns(),9999),x,y);
+		x = MSG_blitChar(DIGIT_SLASH,x,y);
+		x = MSG_blitInt(MIN(SND_getOverruns(),9999),x,y);
+		
 		if (x>top_width) top_width = x; // keep the largest width because triple buffer
 	}
 	
@@ -2815,15 +2575,93 @@ static void video_refresh_callback(const void *data, unsigned width, unsigned he
 
 ///////////////////////////////
 
-// NOTE: sound must be disabled for fast forward to work...
+// per-sample cores (eg. fceumm, pokemini) are staged 
+// and flushed after each run (or when full) so 
+// they hit the batch path like everyone else
+#define AUDIO_STAGING_FRAMES 1024 // more than a frame's worth at 48kHz
+
+static SND_Frame audio_staging[AUDIO_STAGING_FRAMES];
+static int audio_staged = 0;
+
+static void flushAudio(void) {
+	if (!audio_staged) return;
+	SND_batchSamples(audio_staging, audio_staged);
+	audio_staged = 0;
+}
+
+// NOTE: sound must be muted or skipped (see SND_setFastForward()) for fast forward to work...
 static void audio_sample_callback(int16_t left, int16_t right) {
-	if (!fast_forward) SND_batchSamples(&(const SND_Frame){left,right}, 1);
+	if (fast_forward && !ff_audio) return;
+	audio_staging[audio_staged++] = (SND_Frame){left,right};
+	if (audio_staged==AUDIO_STAGING_FRAMES) flushAudio();
 }
 static size_t audio_sample_batch_callback(const int16_t *data, size_t frames) { 
-	if (!fast_forward) return SND_batchSamples((const SND_Frame*)data, frames);
+	if (!fast_forward || ff_audio) {
+		flushAudio(); // keep order if a core mixes both
+		return SND_batchSamples((const SND_Frame*)data, frames);
+	}
 	else return frames;
 };
 
+// cores with their own frameskip decide from this, reported before every run,
+// fixed frameskip just tells them an underrun is likely on the frames to skip
+static void reportAudioBuffer(void) {
+	static int skipped = 0;
+	if (!core.audio_buffer_status) return;
+	
+	int occupancy = SND_getBufferFill();
+	bool active = frameskip!=FRAMESKIP_OFF && !(fast_forward && !ff_audio);
+	bool underrun_likely = false;
+	switch (frameskip) {
+		case FRAMESKIP_OFF: break;
+		case FRAMESKIP_AUTO: underrun_likely = occupancy<FRAMESKIP_AUTO_OCCUPANCY; break;
+		case FRAMESKIP_THRESHOLD: underrun_likely = occupancy<atoi(frameskip_threshold_values[frameskip_threshold]); break;
+		default: {
+			int interval = frameskip - FRAMESKIP_FIXED + 1;
+			underrun_likely = skipped<interval;
+			skipped = underrun_likely ? skipped + 1 : 0;
+		} break;
+	}
+	core.audio_buffer_status(active, occupancy, underrun_likely);
+}
+
+// and for cores that don't take the audio buffer status the frontend 
+// skips the scaler and flip itself, auto compares the measured frame 
+// time against core.fps' budget. cores that check GET_AUDIO_VIDEO_ENABLE
+// also skip rendering
+#define FRAMESKIP_MAX 3 // in a row, so the picture never stalls
+static void updateFrameskip(void) {
+	static uint64_t last_time = 0;
+	static int64_t lag = 0; // us behind schedule
+	static int skipped = 0;
+	
+	uint64_t now = getMicroseconds();
+	int64_t budget = 1000000 / core.fps;
+	int64_t elapsed = last_time ? now - last_time : budget;
+	last_time = now;
+	
+	skip_video = 0;
+	if (frameskip==FRAMESKIP_OFF || core.audio_buffer_status || fast_forward) {
+		lag = 0;
+		skipped = 0;
+		return;
+	}
+	
+	int64_t over = elapsed - budget;
+	if (over>0 && over<budget/100) over = 0; // eg. a 60.1fps core on a 60Hz screen isn't behind
+	lag += over;
+	if (lag<-budget) lag = -budget; // don't bank time
+	if (lag>budget*FRAMESKIP_MAX*2) lag = budget*FRAMESKIP_MAX*2; // eg. after the menu, or hopelessly slow
+	
+	switch (frameskip) {
+		case FRAMESKIP_AUTO: skip_video = lag>budget; break;
+		case FRAMESKIP_THRESHOLD: skip_video = SND_getBufferFill()<atoi(frameskip_threshold_values[frameskip_threshold]); break;
+		default: skip_video = skipped<frameskip - FRAMESKIP_FIXED + 1; break;
+	}
+	if (frameskip<FRAMESKIP_FIXED && skipped>=FRAMESKIP_MAX) skip_video = 0;
+	skipped = skip_video ? skipped + 1 : 0;
+}
+
 ///////////////////////////////////////
 
 void Core_getName(char* in_name, char* out_name) {
@@ -3586,7 +3424,7 @@ static int Menu_options(MenuList* list) {
 					for (int i=0; i<count; i++) {
 						MenuItem* item = &items[i];
 						int w = 0;
-						TTF_SizeUTF8(font.small, item->name, &w, NULL);
+						w = GFX_getTextWidth(font.small, item->name);
 						w += SCALE1(OPTION_PADDING*2);
 						if (w>mw) mw = w;
 					}
@@ -3605,7 +3443,7 @@ static int Menu_options(MenuList* list) {
 					if (j==selected_row) {
 						// move out of conditional if centering
 						int w = 0;
-						TTF_SizeUTF8(font.small, item->name, &w, NULL);
+						w = GFX_getTextWidth(font.small, item->name);
 						w += SCALE1(OPTION_PADDING*2);
 						
 						GFX_blitPill(ASSET_BUTTON, screen, &(SDL_Rect){
@@ -3618,12 +3456,11 @@ static int Menu_options(MenuList* list) {
 						
 						if (item->desc) desc = item->desc;
 					}
-					text = TTF_RenderUTF8_Blended(font.small, item->name, text_color);
+					text = GFX_getText(font.small, item->name, text_color);
 					SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 						ox+SCALE1(OPTION_PADDING),
 						oy+SCALE1((j*BUTTON_SIZE)+1)
 					});
-					SDL_FreeSurface(text);
 				}
 			}
 			else if (type==MENU_FIXED) {
@@ -3651,19 +3488,18 @@ static int Menu_options(MenuList* list) {
 					}
 					
 					if (item->value>=0) {
-						text = TTF_RenderUTF8_Blended(font.tiny, item->values[item->value], COLOR_WHITE); // always white
+						text = GFX_getText(font.tiny, item->values[item->value], COLOR_WHITE); // always white
 						SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 							ox + mw - text->w - SCALE1(OPTION_PADDING),
 							oy+SCALE1((j*BUTTON_SIZE)+3)
 						});
-						SDL_FreeSurface(text);
 					}
 					
 					// TODO: blit a black pill on unselected rows (to cover longer item->values?) or truncate longer item->values?
 					if (j==selected_row) {
 						// white pill
 						int w = 0;
-						TTF_SizeUTF8(font.small, item->name, &w, NULL);
+						w = GFX_getTextWidth(font.small, item->name);
 						w += SCALE1(OPTION_PADDING*2);
 						GFX_blitPill(ASSET_BUTTON, screen, &(SDL_Rect){
 							ox,
@@ -3675,12 +3511,11 @@ static int Menu_options(MenuList* list) {
 						
 						if (item->desc) desc = item->desc;
 					}
-					text = TTF_RenderUTF8_Blended(font.small, item->name, text_color);
+					text = GFX_getText(font.small, item->name, text_color);
 					SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 						ox+SCALE1(OPTION_PADDING),
 						oy+SCALE1((j*BUTTON_SIZE)+1)
 					});
-					SDL_FreeSurface(text);
 				}
 			}
 			else if (type==MENU_VAR || type==MENU_INPUT) {
@@ -3693,13 +3528,13 @@ static int Menu_options(MenuList* list) {
 						int w = 0;
 						int lw = 0;
 						int rw = 0;
-						TTF_SizeUTF8(font.small, item->name, &lw, NULL);
+						lw = GFX_getTextWidth(font.small, item->name);
 						
 						// every value list in an input table is the same
 						// so only calculate rw for the first item...
 						if (!mrw || type!=MENU_INPUT) {
 							for (int j=0; item->values[j]; j++) {
-								TTF_SizeUTF8(font.tiny, item->values[j], &rw, NULL);
+								rw = GFX_getTextWidth(font.tiny, item->values[j]);
 								if (lw+rw>w) w = lw+rw;
 								if (rw>mrw) mrw = rw;
 							}
@@ -3733,7 +3568,7 @@ static int Menu_options(MenuList* list) {
 						
 						// white pill
 						int w = 0;
-						TTF_SizeUTF8(font.small, item->name, &w, NULL);
+						w = GFX_getTextWidth(font.small, item->name);
 						w += SCALE1(OPTION_PADDING*2);
 						GFX_blitPill(ASSET_BUTTON, screen, &(SDL_Rect){
 							ox,
@@ -3745,23 +3580,21 @@ static int Menu_options(MenuList* list) {
 						
 						if (item->desc) desc = item->desc;
 					}
-					text = TTF_RenderUTF8_Blended(font.small, item->name, text_color);
+					text = GFX_getText(font.small, item->name, text_color);
 					SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 						ox+SCALE1(OPTION_PADDING),
 						oy+SCALE1((j*BUTTON_SIZE)+1)
 					});
-					SDL_FreeSurface(text);
 					
 					if (await_input && j==selected_row) {
 						// buh
 					}
 					else if (item->value>=0) {
-						text = TTF_RenderUTF8_Blended(font.tiny, item->values[item->value], COLOR_WHITE); // always white
+						text = GFX_getText(font.tiny, item->values[item->value], COLOR_WHITE); // always white
 						SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 							ox + mw - text->w - SCALE1(OPTION_PADDING),
 							oy+SCALE1((j*BUTTON_SIZE)+3)
 						});
-						SDL_FreeSurface(text);
 					}
 				}
 			}
@@ -3844,6 +3677,7 @@ static void Menu_loop(void) {
 	POW_warn(0);
 	POW_setCPUSpeed(CPU_SPEED_MENU); // set Hz directly
 	GFX_setVsync(VSYNC_STRICT);
+	GFX_setThreaded(0);
 	
 	int rumble_strength = VIB_getStrength();
 	VIB_setStrength(0);
@@ -4067,7 +3901,7 @@ static void Menu_loop(void) {
 			max_width = MIN(max_width, text_width);
 
 			SDL_Surface* text;
-			text = TTF_RenderUTF8_Blended(font.large, display_name, COLOR_WHITE);
+			text = GFX_getText(font.large, display_name, COLOR_WHITE);
 			GFX_blitPill(ASSET_BLACK_PILL, screen, &(SDL_Rect){
 				SCALE1(PADDING),
 				SCALE1(PADDING),
@@ -4083,7 +3917,6 @@ static void Menu_loop(void) {
 				SCALE1(PADDING+BUTTON_PADDING),
 				SCALE1(PADDING+4)
 			});
-			SDL_FreeSurface(text);
 			
 			if (show_setting) {
 				if (show_setting==1) GFX_blitButtonGroup((char*[]){ BRIGHTNESS_BUTTON_LABEL,"BRIGHTNESS",  NULL }, screen, 0);
@@ -4107,15 +3940,14 @@ static void Menu_loop(void) {
 							screen->w - SCALE1(PADDING * 2),
 							SCALE1(PILL_SIZE)
 						});
-						text = TTF_RenderUTF8_Blended(font.large, disc_name, COLOR_WHITE);
+						text = GFX_getText(font.large, disc_name, COLOR_WHITE);
 						SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 							screen->w - SCALE1(PADDING + BUTTON_PADDING) - text->w,
 							SCALE1(oy + PADDING + 4)
 						});
-						SDL_FreeSurface(text);
 					}
 					
-					TTF_SizeUTF8(font.large, item, &ow, NULL);
+					ow = GFX_getTextWidth(font.large, item);
 					ow += SCALE1(BUTTON_PADDING*2);
 					
 					// pill
@@ -4129,21 +3961,19 @@ static void Menu_loop(void) {
 				}
 				else {
 					// shadow
-					text = TTF_RenderUTF8_Blended(font.large, item, COLOR_BLACK);
+					text = GFX_getText(font.large, item, COLOR_BLACK);
 					SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 						SCALE1(2 + PADDING + BUTTON_PADDING),
 						SCALE1(1 + PADDING + oy + (i * PILL_SIZE) + 4)
 					});
-					SDL_FreeSurface(text);
 				}
 				
 				// text
-				text = TTF_RenderUTF8_Blended(font.large, item, text_color);
+				text = GFX_getText(font.large, item, text_color);
 				SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){
 					SCALE1(PADDING + BUTTON_PADDING),
 					SCALE1(oy + PADDING + (i * PILL_SIZE) + 4)
 				});
-				SDL_FreeSurface(text);
 			}
 			
 			// slot preview
@@ -4209,6 +4039,7 @@ static void Menu_loop(void) {
 		GFX_flip(screen);
 
 		GFX_setVsync(prevent_tearing); // restore vsync value
+		GFX_setThreaded(threaded_present);
 		setOverclock(overclock); // restore overclock value
 		if (rumble_strength) VIB_setStrength(rumble_strength);
 	}
@@ -4288,6 +4119,7 @@ static void limitFF(void) {
 }
 
 int main(int argc , char* argv[]) {
+	TRACE_INIT("minarch");
 	LOG_info("MinArch\n");
 	InitSettings();
 
@@ -4321,7 +4153,11 @@ int main(int argc , char* argv[]) {
 	Config_init();
 	Config_readOptions(); // cores with boot logo option (eg. gb) need to load options early
 	setOverclock(overclock);
+	setResampler(audio_resampler); // in case no cfg set them
+	setLatency(audio_latency);
+	setFilter(audio_filter);
 	GFX_setVsync(prevent_tearing);
+	GFX_setThreaded(threaded_present);
 	
 	Core_init();
 	
@@ -4349,7 +4185,11 @@ int main(int argc , char* argv[]) {
 	while (!quit) {
 		GFX_startFrame();
 		
+		SND_setFastForward(fast_forward ? ff_audio : SND_FF_OFF); // ff_audio matches SND_FF_*
+		updateFrameskip();
+		reportAudioBuffer();
 		core.run();
+		flushAudio();
 		limitFF();
 		
 		if (show_menu) Menu_loop();
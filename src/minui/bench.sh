@@ -0,0 +1,75 @@
+#!/bin/sh
+# boot-to-menu benchmark, run on device after `make bench`
+# builds a synthetic card at BENCH_PATH (must match the makefile) and reports
+# when minui-bench.elf's first frame ended (from TRACE_INIT) with last.txt
+# pointing into a rom folder, cold (no index) then warm
+
+BENCH_PATH=/tmp/bench
+SDCARD_PATH=/mnt/sdcard
+PLATFORM=rg35xx
+RUNS=${RUNS:-5}
+FOLDERS=${FOLDERS:-20}
+ROMS=${ROMS:-500}
+
+cd $(dirname "$0")
+if [ ! -f ./minui-bench.elf ]; then
+	echo "missing minui-bench.elf, run make bench first"
+	exit 1
+fi
+
+export LD_LIBRARY_PATH=$SDCARD_PATH/.system/$PLATFORM/lib:$LD_LIBRARY_PATH
+
+# synthetic card, system files come from the real one
+rm -rf "$BENCH_PATH"
+mkdir -p "$BENCH_PATH/Roms" "$BENCH_PATH/.userdata/$PLATFORM/.minui" "$BENCH_PATH/.userdata/$PLATFORM/logs"
+ln -s "$SDCARD_PATH/.system" "$BENCH_PATH/.system"
+ln -s "$SDCARD_PATH/Emus" "$BENCH_PATH/Emus" 2>/dev/null
+# the font atlas is keyed to the real font so the card's copy stays valid here
+ATLAS=.userdata/$PLATFORM/.minui/font.atlas
+[ -f "$SDCARD_PATH/$ATLAS" ] && cp "$SDCARD_PATH/$ATLAS" "$BENCH_PATH/$ATLAS"
+
+RECENT=$BENCH_PATH/.userdata/$PLATFORM/.minui/recent.txt
+FAVORITE=$BENCH_PATH/.userdata/$PLATFORM/.minui/favorite.txt
+TAGS=$(ls "$SDCARD_PATH/.system/$PLATFORM/paks/Emus" | sed 's/\.pak$//')
+i=0
+for TAG in $TAGS; do
+	[ $i -ge $FOLDERS ] && break
+	FOLDER="$BENCH_PATH/Roms/System $i ($TAG)"
+	mkdir -p "$FOLDER"
+	j=0
+	while [ $j -lt $ROMS ]; do
+		touch "$FOLDER/Game $j.rom"
+		j=$((j+1))
+	done
+	echo "/Roms/System $i ($TAG)/Game 1.rom" >> "$RECENT"
+	echo "/Roms/System $i ($TAG)/Game 2.rom" >> "$FAVORITE"
+	i=$((i+1))
+done
+
+# loadLast() reads the real /tmp/last.txt, point it into a rom folder so the
+# folder's index is what the cold and warm runs differ by
+[ -f /tmp/last.txt ] && mv /tmp/last.txt /tmp/last.txt.bench
+LAST="$(ls -d "$BENCH_PATH/Roms/"* | head -n 1)/Game $((ROMS/2)).rom"
+
+# Index_save() skips folders modified within the last 2 seconds
+sleep 2
+
+# untimed warm-up, bakes the font atlas if there wasn't one to copy
+echo "$LAST" > /tmp/last.txt
+./minui-bench.elf > /dev/null 2>&1
+
+TRACE_PATH=$BENCH_PATH/.userdata/$PLATFORM/logs/minui.trace.txt
+run=0
+while [ $run -lt $RUNS ]; do
+	[ $run -eq 0 ] && rm -rf "$BENCH_PATH/.userdata/$PLATFORM/.minui/index" # only the folder index
+	echo "$LAST" > /tmp/last.txt
+	sync
+	./minui-bench.elf > /dev/null 2>&1
+	MS=$(awk '$2=="E" && $3=="first" { printf "%.1f", $1/1000 }' "$TRACE_PATH")
+	[ $run -eq 0 ] && echo "cold: ${MS}ms" || echo "warm: ${MS}ms"
+	run=$((run+1))
+done
+echo "last trace: $TRACE_PATH"
+
+rm -f /tmp/last.txt
+[ -f /tmp/last.txt.bench ] && mv /tmp/last.txt.bench /tmp/last.txt
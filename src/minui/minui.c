@@ -9,9 +9,15 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "defines.h"
 #include "utils.h"
+#include "strmap.h"
+#include "trace.h"
 #include "api.h"
 
 ///////////////////////////////////////
@@ -78,29 +84,35 @@ static void StringArray_free(Array* self) {
 ///////////////////////////////////////
 
 typedef struct Hash {
-	Array* keys;
-	Array* values;
-} Hash; // not really a hash
+	StrMap* map; // owns its keys and values
+} Hash; // actually a hash now
 
 static Hash* Hash_new(void) {
 	Hash* self = malloc(sizeof(Hash));
-	self->keys = Array_new();
-	self->values = Array_new();
+	self->map = StrMap_new(0);
 	return self;
 }
 static void Hash_free(Hash* self) {
-	StringArray_free(self->keys);
-	StringArray_free(self->values);
+	for (int i=0; i<self->map->capacity; i++) {
+		StrMapSlot* slot = &self->map->slots[i];
+		if (!slot->hash) continue;
+		free(slot->key);
+		free(slot->value);
+	}
+	StrMap_free(self->map);
 	free(self);
 }
 static void Hash_set(Hash* self, char* key, char* value) {
-	Array_push(self->keys, strdup(key));
-	Array_push(self->values, strdup(value));
+	char* old = StrMap_get(self->map, key);
+	if (old) {
+		free(old);
+		StrMap_set(self->map, key, strdup(value)); // keeps the existing key
+		return;
+	}
+	StrMap_set(self->map, strdup(key), strdup(value));
 }
 static char* Hash_get(Hash* self, char* key) {
-	int i = StringArray_indexOf(self->keys, key);
-	if (i==-1) return NULL;
-	return self->values->items[i];
+	return StrMap_get(self->map, key);
 }
 
 ///////////////////////////////////////
@@ -111,52 +123,102 @@ enum EntryType {
 	ENTRY_ROM,
 };
 typedef struct Entry {
-	char* path;
-	char* name;
-	char* unique;
-	int type;
-	int alpha; // index in parent Directory's alphas Array, which points to the index of an Entry in its entries Array :sweat_smile:
+	uint32_t path; // offsets into the owning EntryArray's strings
+	uint32_t name;
+	uint32_t unique; // 0 (an empty string) if none
+	uint16_t path_len;
+	uint16_t name_len;
+	uint16_t unique_len;
+	uint8_t type;
+	uint8_t alpha; // index in parent Directory's alphas Array, which points to the index of an Entry in its entries Array :sweat_smile:
 } Entry;
 
-static Entry* Entry_new(char* path, int type) {
-	char display_name[256];
-	getDisplayName(path, display_name);
-	Entry* self = malloc(sizeof(Entry));
-	self->path = strdup(path);
-	self->name = strdup(display_name);
-	self->unique = NULL;
-	self->type = type;
-	self->alpha = 0;
+// a folder of 10k roms used to be 40k tiny mallocs, now it's two blocks
+typedef struct EntryArray {
+	int count;
+	int capacity;
+	Entry* items;
+	char* strings; // arena for every path, name and unique, NOTE: may move while pushing so only hold on to offsets
+	uint32_t strings_size;
+	uint32_t strings_capacity;
+} EntryArray;
+
+static EntryArray* EntryArray_new(void) {
+	EntryArray* self = malloc(sizeof(EntryArray));
+	self->count = 0;
+	self->capacity = 32;
+	self->items = malloc(sizeof(Entry) * self->capacity);
+	self->strings_capacity = 4096;
+	self->strings = malloc(self->strings_capacity);
+	self->strings[0] = '\0'; // so offset 0 can mean NULL
+	self->strings_size = 1;
 	return self;
 }
-static void Entry_free(Entry* self) {
-	free(self->path);
-	free(self->name);
-	if (self->unique) free(self->unique);
-	free(self);
+static uint32_t EntryArray_addString(EntryArray* self, char* str, int len) {
+	if (self->strings_size+len+1>self->strings_capacity) {
+		while (self->strings_size+len+1>self->strings_capacity) self->strings_capacity *= 2;
+		self->strings = realloc(self->strings, self->strings_capacity);
+	}
+	uint32_t offset = self->strings_size;
+	memcpy(self->strings+offset, str, len);
+	self->strings[offset+len] = '\0';
+	self->strings_size += len + 1;
+	return offset;
 }
-
-static int EntryArray_indexOf(Array* self, char* path) {
-	for (int i=0; i<self->count; i++) {
-		Entry* entry = self->items[i];
-		if (exactMatch(entry->path, path)) return i;
+static Entry* EntryArray_pushNamed(EntryArray* self, char* path, char* name, int type) { // path and name must not point into self->strings
+	if (self->count>=self->capacity) {
+		self->capacity *= 2;
+		self->items = realloc(self->items, sizeof(Entry) * self->capacity);
 	}
-	return -1;
+	Entry* entry = &self->items[self->count++];
+	entry->path_len = strlen(path);
+	entry->name_len = strlen(name);
+	entry->path = EntryArray_addString(self, path, entry->path_len);
+	entry->name = EntryArray_addString(self, name, entry->name_len);
+	entry->unique = 0;
+	entry->unique_len = 0;
+	entry->type = type;
+	entry->alpha = 0;
+	return entry;
+}
+static Entry* EntryArray_push(EntryArray* self, char* path, int type) {
+	char display_name[256];
+	getDisplayName(path, display_name);
+	return EntryArray_pushNamed(self, path, display_name, type);
+}
+
+static inline char* EntryArray_path(EntryArray* self, Entry* entry) {
+	return self->strings + entry->path;
+}
+static inline char* EntryArray_name(EntryArray* self, Entry* entry) {
+	return self->strings + entry->name;
+}
+static inline char* EntryArray_unique(EntryArray* self, Entry* entry) {
+	return entry->unique ? self->strings + entry->unique : NULL;
+}
+static void EntryArray_setUnique(EntryArray* self, Entry* entry, char* unique) { // unique must not point into self->strings
+	entry->unique_len = strlen(unique);
+	entry->unique = EntryArray_addString(self, unique, entry->unique_len); // any previous unique is just abandoned in the arena
 }
+static Entry* EntryArray_append(EntryArray* self, EntryArray* other, Entry* entry) { // copy an entry from another array
+	return EntryArray_pushNamed(self, EntryArray_path(other, entry), EntryArray_name(other, entry), entry->type);
+}
+
+static __thread char* sort_strings; // qsort() doesn't take a context
 static int EntryArray_sortEntry(const void* a, const void* b) {
-	Entry* item1 = *(Entry**)a;
-	Entry* item2 = *(Entry**)b;
-	return strcasecmp(item1->name, item2->name);
+	const Entry* item1 = a;
+	const Entry* item2 = b;
+	return strcasecmp(sort_strings+item1->name, sort_strings+item2->name);
 }
-static void EntryArray_sort(Array* self) {
-	qsort(self->items, self->count, sizeof(void*), EntryArray_sortEntry);
+static void EntryArray_sort(EntryArray* self) {
+	sort_strings = self->strings;
+	qsort(self->items, self->count, sizeof(Entry), EntryArray_sortEntry);
 }
 
-static void EntryArray_free(Array* self) {
-	for (int i=0; i<self->count; i++) {
-		Entry_free(self->items[i]);
-	}
-	Array_free(self);
+static void EntryArray_free(EntryArray* self) {
+	free(self->items);
+	free(self->strings);
+	free(self);
 }
 
 ///////////////////////////////////////
@@ -181,15 +243,33 @@ static void IntArray_free(IntArray* self) {
 
 ///////////////////////////////////////
 
+typedef struct DirectoryLoader {
+	char* path;
+	pthread_t thread;
+	pthread_mutex_t lock; // guards entries, alphas and done
+	EntryArray* entries; // latest first page or the final entries, waiting for Directory_poll()
+	IntArray* alphas; // only set with the final entries
+	int done;
+	volatile int cancel;
+	// loader thread only
+	int rows[MAIN_ROW_COUNT]; // first page so far, indexes into the entries being read
+	int row_count;
+	int changed;
+	uint64_t published_at;
+} DirectoryLoader;
+
 typedef struct Directory {
 	char* path;
 	char* name;
-	Array* entries;
+	EntryArray* entries;
 	IntArray* alphas;
+	StrMap* paths; // entry path -> index+1, built by the first Directory_indexOf()
+	DirectoryLoader* loader; // non-NULL while entries is just a preview of the first page
 	// rendering
 	int selected;
 	int start;
 	int end;
+	int restore_end; // end to restore once a background load finishes, 0 to reset
 } Directory;
 
 static int getIndexChar(char* str) {
@@ -199,13 +279,12 @@ static int getIndexChar(char* str) {
 	return i;
 }
 
-static void getUniqueName(Entry* entry, char* out_name) {
-	char* filename = strrchr(entry->path, '/')+1;
+static void getUniqueName(EntryArray* entries, Entry* entry, char* out_name) {
 	char emu_tag[256];
-	getEmuName(entry->path, emu_tag);
+	getEmuName(EntryArray_path(entries, entry), emu_tag);
 	
 	char *tmp;
-	strcpy(out_name, entry->name);
+	strcpy(out_name, EntryArray_name(entries, entry));
 	tmp = out_name + strlen(out_name);
 	strcpy(tmp, " (");
 	tmp = out_name + strlen(out_name);
@@ -214,40 +293,38 @@ static void getUniqueName(Entry* entry, char* out_name) {
 	strcpy(tmp, ")");
 }
 
-static void Directory_index(Directory* self) {
-	int skip_index = exactMatch(FAUX_RECENT_PATH, self->path) || exactMatch(FAUX_FAVORITE_PATH, self->path) || prefixMatch(COLLECTIONS_PATH, self->path); // not alphabetized
+static void indexEntries(char* path, EntryArray* entries, IntArray* alphas) {
+	int skip_index = exactMatch(FAUX_RECENT_PATH, path) || exactMatch(FAUX_FAVORITE_PATH, path) || prefixMatch(COLLECTIONS_PATH, path); // not alphabetized
 	
 	Entry* prior = NULL;
 	int alpha = -1;
 	int index = 0;
-	for (int i=0; i<self->entries->count; i++) {
-		Entry* entry = self->entries->items[i];
-		if (prior!=NULL && exactMatch(prior->name, entry->name)) {
-			if (prior->unique) free(prior->unique);
-			if (entry->unique) free(entry->unique);
+	for (int i=0; i<entries->count; i++) {
+		Entry* entry = &entries->items[i];
+		if (prior!=NULL && exactMatch(EntryArray_name(entries, prior), EntryArray_name(entries, entry))) {
+			char prior_unique[256];
+			char entry_unique[256];
 			
-			char* prior_filename = strrchr(prior->path, '/')+1;
-			char* entry_filename = strrchr(entry->path, '/')+1;
+			char* prior_filename = strrchr(EntryArray_path(entries, prior), '/')+1;
+			char* entry_filename = strrchr(EntryArray_path(entries, entry), '/')+1;
 			if (exactMatch(prior_filename, entry_filename)) {
-				char prior_unique[256];
-				char entry_unique[256];
-				getUniqueName(prior, prior_unique);
-				getUniqueName(entry, entry_unique);
-				
-				prior->unique = strdup(prior_unique);
-				entry->unique = strdup(entry_unique);
+				getUniqueName(entries, prior, prior_unique);
+				getUniqueName(entries, entry, entry_unique);
 			}
 			else {
-				prior->unique = strdup(prior_filename);
-				entry->unique = strdup(entry_filename);
+				strcpy(prior_unique, prior_filename);
+				strcpy(entry_unique, entry_filename);
 			}
+			// NOTE: copied first because these can move the strings
+			EntryArray_setUnique(entries, prior, prior_unique);
+			EntryArray_setUnique(entries, entry, entry_unique);
 		}
 
 		if (!skip_index) {
-			int a = getIndexChar(entry->name);
+			int a = getIndexChar(EntryArray_name(entries, entry));
 			if (a!=alpha) {
-				index = self->alphas->count;
-				IntArray_push(self->alphas, i);
+				index = alphas->count;
+				IntArray_push(alphas, i);
 				alpha = a;
 			}
 			entry->alpha = index;
@@ -256,13 +333,20 @@ static void Directory_index(Directory* self) {
 		prior = entry;
 	}
 }
+static void Directory_index(Directory* self) {
+	indexEntries(self->path, self->entries, self->alphas);
+}
 
-static Array* getRoot(void);
-static Array* getRecents(void);
-static Array* getFavorites(void);
-static Array* getCollection(char* path);
-static Array* getDiscs(char* path);
-static Array* getEntries(char* path);
+static EntryArray* getRoot(void);
+static EntryArray* getRecents(void);
+static EntryArray* getFavorites(void);
+static EntryArray* getCollection(char* path);
+static EntryArray* getDiscs(char* path);
+static EntryArray* getEntries(char* path, Array* sources, DirectoryLoader* loader);
+static int Index_load(Directory* self);
+static void Index_save(char* path, EntryArray* entries, IntArray* alphas, Array* sources);
+static DirectoryLoader* DirectoryLoader_new(char* path);
+static void DirectoryLoader_free(DirectoryLoader* self);
 
 static Directory* Directory_new(char* path, int selected) {
 	char display_name[256];
@@ -271,6 +355,15 @@ static Directory* Directory_new(char* path, int selected) {
 	Directory* self = malloc(sizeof(Directory));
 	self->path = strdup(path);
 	self->name = strdup(display_name);
+	self->alphas = IntArray_new();
+	self->paths = NULL;
+	self->loader = NULL;
+	self->selected = selected;
+	self->start = 0;
+	self->end = 0;
+	self->restore_end = 0;
+	
+	int indexed = 0;
 	if (exactMatch(path, SDCARD_PATH)) {
 		self->entries = getRoot();
 	}
@@ -286,21 +379,38 @@ static Directory* Directory_new(char* path, int selected) {
 	else if (suffixMatch(".m3u", path)) {
 		self->entries = getDiscs(path);
 	}
+	else if (Index_load(self)) {
+		indexed = 1; // already sorted and indexed
+	}
 	else {
-		self->entries = getEntries(path);
+		// read, sort and index on a thread so we can show the first page asap, see Directory_poll()
+		self->entries = EntryArray_new(); // empty until the loader's first page arrives
+		self->loader = DirectoryLoader_new(path);
+		return self;
 	}
-	self->alphas = IntArray_new();
-	self->selected = selected;
-	Directory_index(self);
+	if (!indexed) Directory_index(self);
 	return self;
 }
 static void Directory_free(Directory* self) {
+	if (self->loader) DirectoryLoader_free(self->loader); // cancels and waits
 	free(self->path);
 	free(self->name);
 	EntryArray_free(self->entries);
 	IntArray_free(self->alphas);
+	if (self->paths) StrMap_free(self->paths);
 	free(self);
 }
+static int Directory_indexOf(Directory* self, char* path) {
+	if (!self->paths) {
+		// NOTE: keys point into the entries' strings which don't change once the Directory is indexed
+		self->paths = StrMap_new(self->entries->count);
+		for (int i=self->entries->count-1; i>=0; i--) { // backwards so the first of any duplicates wins
+			Entry* entry = &self->entries->items[i];
+			StrMap_set(self->paths, EntryArray_path(self->entries, entry), (void*)(intptr_t)(i+1));
+		}
+	}
+	return (int)(intptr_t)StrMap_get(self->paths, path) - 1;
+}
 
 static void DirectoryArray_pop(Array* self) {
 	Directory_free(Array_pop(self));
@@ -317,6 +427,7 @@ static void DirectoryArray_free(Array* self) {
 typedef struct Recent {
 	char* path; // NOTE: this is without the SDCARD_PATH prefix!
 	int available;
+	int index; // position in recents, kept current by the RecentArray helpers
 } Recent;
 static int hasEmu(char* emu_name);
 static Recent* Recent_new(char* path) {
@@ -337,12 +448,28 @@ static void Recent_free(Recent* self) {
 	free(self);
 }
 
-static int RecentArray_indexOf(Array* self, char* str) {
+static int RecentArray_indexOf(StrMap* paths, char* str) {
+	Recent* recent = StrMap_get(paths, str);
+	return recent ? recent->index : -1;
+}
+static void RecentArray_push(Array* self, Recent* recent) {
+	recent->index = self->count;
+	Array_push(self, recent);
+}
+static void RecentArray_unshift(Array* self, Recent* recent) {
+	Array_unshift(self, recent);
 	for (int i=0; i<self->count; i++) {
-		Recent* item = self->items[i];
-		if (exactMatch(item->path, str)) return i;
+		((Recent*)self->items[i])->index = i;
 	}
-	return -1;
+}
+static void RecentArray_bump(Array* self, int index) {
+	Recent* recent = self->items[index];
+	for (int i=index; i>0; i--) {
+		self->items[i] = self->items[i-1];
+		((Recent*)self->items[i])->index = i;
+	}
+	self->items[0] = recent;
+	recent->index = 0;
 }
 static void RecentArray_free(Array* self) {
 	for (int i=0; i<self->count; i++) {
@@ -356,6 +483,7 @@ static void RecentArray_free(Array* self) {
 typedef struct Favorite {
 	char* path; // NOTE: this is without the SDCARD_PATH prefix!
 	int available;
+	int index; // position in favorites, kept current by the FavoriteArray helpers
 } Favorite;
 static Favorite* Favorite_new(char* path) {
 	Favorite* self = malloc(sizeof(Favorite));
@@ -375,12 +503,19 @@ static void Favorite_free(Favorite* self) {
 	free(self);
 }
 
-static int FavoriteArray_indexOf(Array* self, char* str) {
+static int FavoriteArray_indexOf(StrMap* paths, char* str) {
+	Favorite* favorite = StrMap_get(paths, str);
+	return favorite ? favorite->index : -1;
+}
+static void FavoriteArray_push(Array* self, Favorite* favorite) {
+	favorite->index = self->count;
+	Array_push(self, favorite);
+}
+static void FavoriteArray_unshift(Array* self, Favorite* favorite) {
+	Array_unshift(self, favorite);
 	for (int i=0; i<self->count; i++) {
-		Favorite* item = self->items[i];
-		if (exactMatch(item->path, str)) return i;
+		((Favorite*)self->items[i])->index = i;
 	}
-	return -1;
 }
 static void FavoriteArray_free(Array* self) {
 	for (int i=0; i<self->count; i++) {
@@ -392,6 +527,7 @@ static int FavoriteArray_splice(Array* self, int index) {
 	if (index != -1) {
 		for(int i=index; i<self->count-1; i++) {
 			self->items[i] = self->items[i+1];
+			((Favorite*)self->items[i])->index = i;
 		}
 		--self->count;
 	}
@@ -404,6 +540,8 @@ static Directory* top;
 static Array* stack; // DirectoryArray
 static Array* recents; // RecentArray
 static Array* favorites; // FavoriteArray
+static StrMap* recent_paths; // path -> Recent in recents
+static StrMap* favorite_paths; // path -> Favorite in favorites
 
 static int quit = 0;
 static int can_resume = 0;
@@ -418,6 +556,15 @@ static int restore_end = 0;
 
 ///////////////////////////////////////
 
+static void pushRecent(Recent* recent) {
+	if (!StrMap_get(recent_paths, recent->path)) StrMap_set(recent_paths, recent->path, recent);
+	RecentArray_push(recents, recent);
+}
+static void pushFavorite(Favorite* favorite) {
+	if (!StrMap_get(favorite_paths, favorite->path)) StrMap_set(favorite_paths, favorite->path, favorite);
+	FavoriteArray_push(favorites, favorite);
+}
+
 #define MAX_RECENTS 24 // a multiple of all menu rows
 static void saveRecents(void) {
 	FILE* file = fopen(RECENT_PATH, "w");
@@ -432,20 +579,18 @@ static void saveRecents(void) {
 }
 static void addRecent(char* path) {
 	path += strlen(SDCARD_PATH); // makes paths platform agnostic
-	int id = RecentArray_indexOf(recents, path);
+	int id = RecentArray_indexOf(recent_paths, path);
 	if (id==-1) { // add
 		while (recents->count>=MAX_RECENTS) {
-			Recent_free(Array_pop(recents));
-		}
-		Array_unshift(recents, Recent_new(path));
-	}
-	else if (id>0) { // bump to top
-		for (int i=id; i>0; i--) {
-			void* tmp = recents->items[i-1];
-			recents->items[i-1] = recents->items[i];
-			recents->items[i] = tmp;
+			Recent* recent = Array_pop(recents);
+			if (StrMap_get(recent_paths, recent->path)==recent) StrMap_remove(recent_paths, recent->path);
+			Recent_free(recent);
 		}
+		Recent* recent = Recent_new(path);
+		StrMap_set(recent_paths, recent->path, recent);
+		RecentArray_unshift(recents, recent);
 	}
+	else if (id>0) RecentArray_bump(recents, id); // bump to top
 	saveRecents();
 }
 
@@ -462,27 +607,64 @@ static void saveFavorites(void) {
 }
 static void toggleFavorite(char* path) {
 	path += strlen(SDCARD_PATH); // makes paths platform agnostic
-	int id = FavoriteArray_indexOf(favorites, path);
+	int id = FavoriteArray_indexOf(favorite_paths, path);
 	if (id==-1) { // add
-		Array_unshift(favorites, Favorite_new(path));
+		Favorite* favorite = Favorite_new(path);
+		StrMap_set(favorite_paths, favorite->path, favorite);
+		FavoriteArray_unshift(favorites, favorite);
 	} else { // remove
+		Favorite* favorite = favorites->items[id];
+		StrMap_remove(favorite_paths, favorite->path);
 		FavoriteArray_splice(favorites, id);
+		Favorite_free(favorite);
 	}
 	saveFavorites();
 }
 static int isFavorite(char *path) {
 	path += strlen(SDCARD_PATH); // makes paths platform agnostic
-	int id = FavoriteArray_indexOf(favorites, path);
-	return ++id;
+	return StrMap_get(favorite_paths, path)!=NULL;
 }
 
-static int hasEmu(char* emu_name) {
-	char pak_path[256];
-	sprintf(pak_path, "%s/Emus/%s.pak/launch.sh", PAKS_PATH, emu_name);
-	if (exists(pak_path)) return 1;
+// emu name -> launch.sh, scanned once instead of probing the card for every folder and recent
+static Hash* emu_paks;
 
-	sprintf(pak_path, "%s/Emus/%s/%s.pak/launch.sh", SDCARD_PATH, PLATFORM, emu_name);
-	return exists(pak_path);
+static void getEmuKey(char* emu_name, char* key) { // the card is FAT so paks match case-insensitively
+	while (*emu_name) *key++ = tolower(*emu_name++);
+	*key = '\0';
+}
+static void loadEmuPaks(char* emus_path) {
+	DIR* dh = opendir(emus_path);
+	if (!dh) return;
+	
+	struct dirent* dp;
+	char pak_path[256];
+	char key[256];
+	while ((dp = readdir(dh))!=NULL) {
+		if (hide(dp->d_name)) continue;
+		if (!suffixMatch(".pak", dp->d_name)) continue;
+		
+		sprintf(pak_path, "%s/%s/launch.sh", emus_path, dp->d_name);
+		if (!exists(pak_path)) continue;
+		
+		getEmuKey(dp->d_name, key);
+		key[strlen(key)-4] = '\0'; // .pak
+		Hash_set(emu_paks, key, pak_path);
+	}
+	closedir(dh);
+}
+static char* getEmuPak(char* emu_name) { // returns NULL if not installed
+	if (!emu_paks) {
+		emu_paks = Hash_new();
+		loadEmuPaks(PAKS_PATH "/Emus");
+		loadEmuPaks(SDCARD_PATH "/Emus/" PLATFORM); // user paks win, same as getEmuPath()
+	}
+	
+	char key[256];
+	getEmuKey(emu_name, key);
+	return Hash_get(emu_paks, key);
+}
+static int hasEmu(char* emu_name) {
+	return getEmuPak(emu_name)!=NULL;
 }
 static int hasCue(char* dir_path, char* cue_path) { // NOTE: dir_path not rom_path
 	char* tmp = strrchr(dir_path, '/') + 1; // folder name
@@ -520,9 +702,11 @@ static int hasM3u(char* rom_path, char* m3u_path) { // NOTE: rom_path not dir_pa
 }
 
 static int hasRecents(void) {
+	TRACE_SCOPE("hasRecents");
 	int has = 0;
 	
 	Array* parent_paths = Array_new();
+	Hash* m3u_paths = Hash_new(); // rom dir -> m3u path or "", recents tend to share folders
 	if (exists(CHANGE_DISC_PATH)) {
 		char sd_path[256];
 		getFile(CHANGE_DISC_PATH, sd_path, 256);
@@ -530,7 +714,7 @@ static int hasRecents(void) {
 			char* disc_path = sd_path + strlen(SDCARD_PATH); // makes path platform agnostic
 			Recent* recent = Recent_new(disc_path);
 			if (recent->available) has += 1;
-			Array_push(recents, recent);
+			pushRecent(recent);
 		
 			char parent_path[256];
 			strcpy(parent_path, disc_path);
@@ -555,7 +739,16 @@ static int hasRecents(void) {
 				if (recents->count<MAX_RECENTS) {
 					// this logic replaces an existing disc from a multi-disc game with the last used
 					char m3u_path[256];
-					if (hasM3u(sd_path, m3u_path)) { // TODO: this might tank launch speed
+					char dir_path[256];
+					strcpy(dir_path, sd_path);
+					strrchr(dir_path, '/')[0] = '\0';
+					char* cached = Hash_get(m3u_paths, dir_path);
+					if (cached) strcpy(m3u_path, cached);
+					else {
+						if (!hasM3u(sd_path, m3u_path)) m3u_path[0] = '\0';
+						Hash_set(m3u_paths, dir_path, m3u_path);
+					}
+					if (m3u_path[0]) {
 						char parent_path[256];
 						strcpy(parent_path, line);
 						char* tmp = strrchr(parent_path, '/') + 1;
@@ -575,7 +768,7 @@ static int hasRecents(void) {
 					}
 					Recent* recent = Recent_new(line);
 					if (recent->available) has += 1;
-					Array_push(recents, recent);
+					pushRecent(recent);
 				}
 			}
 		}
@@ -585,10 +778,12 @@ static int hasRecents(void) {
 	saveRecents();
 	
 	StringArray_free(parent_paths);
+	Hash_free(m3u_paths);
 	//return has>0;
 	return 1; // Always show directory, even if empty.
 }
 static int hasFavorites(void) {
+	TRACE_SCOPE("hasFavorites");
 	int has = 0;
 
 	FILE* file = fopen(FAVORITE_PATH, "r"); // newest at top
@@ -604,7 +799,7 @@ static int hasFavorites(void) {
 			if (exists(sd_path)) {
 					Favorite* favorite = Favorite_new(line);
 					if (favorite->available) has += 1;
-					Array_push(favorites, favorite);
+					pushFavorite(favorite);
 			}
 		}
 		fclose(file);
@@ -654,15 +849,16 @@ static int hasRoms(char* dir_name) {
 	// if (!has) printf("No roms for %s!\n", dir_name);
 	return has;
 }
-static Array* getRoot(void) {
-	Array* root = Array_new();
+static EntryArray* getRoot(void) {
+	TRACE_SCOPE("getRoot");
+	EntryArray* root = EntryArray_new();
 	
-	if (hasRecents()) Array_push(root, Entry_new(FAUX_RECENT_PATH, ENTRY_DIR));
-	if (hasFavorites()) Array_push(root, Entry_new(FAUX_FAVORITE_PATH, ENTRY_DIR));
+	if (hasRecents()) EntryArray_push(root, FAUX_RECENT_PATH, ENTRY_DIR);
+	if (hasFavorites()) EntryArray_push(root, FAUX_FAVORITE_PATH, ENTRY_DIR);
 	
 	DIR *dh;
 	
-	Array* entries = Array_new();
+	EntryArray* entries = EntryArray_new();
 	dh = opendir(ROMS_PATH);
 	if (dh!=NULL) {
 		struct dirent *dp;
@@ -670,33 +866,30 @@ static Array* getRoot(void) {
 		char full_path[256];
 		sprintf(full_path, "%s/", ROMS_PATH);
 		tmp = full_path + strlen(full_path);
-		Array* emus = Array_new();
+		EntryArray* emus = EntryArray_new();
 		while((dp = readdir(dh)) != NULL) {
 			if (hide(dp->d_name)) continue;
 			if (hasRoms(dp->d_name)) {
 				strcpy(tmp, dp->d_name);
-				Array_push(emus, Entry_new(full_path, ENTRY_DIR));
+				EntryArray_push(emus, full_path, ENTRY_DIR);
 			}
 		}
 		EntryArray_sort(emus);
 		Entry* prev_entry = NULL;
 		for (int i=0; i<emus->count; i++) {
-			Entry* entry = emus->items[i];
+			Entry* entry = &emus->items[i];
 			if (prev_entry!=NULL) {
-				if (exactMatch(prev_entry->name, entry->name)) {
-					Entry_free(entry);
-					continue;
-				}
+				if (exactMatch(EntryArray_name(emus, prev_entry), EntryArray_name(emus, entry))) continue;
 			}
-			Array_push(entries, entry);
+			EntryArray_append(entries, emus, entry);
 			prev_entry = entry;
 		}
-		Array_free(emus); // just free the array part, entries now owns emus entries
+		EntryArray_free(emus);
 		closedir(dh);
 	}
 	
 	if (hasCollections()) {
-		if (entries->count) Array_push(root, Entry_new(COLLECTIONS_PATH, ENTRY_DIR));
+		if (entries->count) EntryArray_push(root, COLLECTIONS_PATH, ENTRY_DIR);
 		else { // no visible systems, promote collections to root
 			dh = opendir(COLLECTIONS_PATH);
 			if (dh!=NULL) {
@@ -705,17 +898,17 @@ static Array* getRoot(void) {
 				char full_path[256];
 				sprintf(full_path, "%s/", COLLECTIONS_PATH);
 				tmp = full_path + strlen(full_path);
-				Array* collections = Array_new();
+				EntryArray* collections = EntryArray_new();
 				while((dp = readdir(dh)) != NULL) {
 					if (hide(dp->d_name)) continue;
 					strcpy(tmp, dp->d_name);
-					Array_push(collections, Entry_new(full_path, ENTRY_DIR)); // yes, collections are fake directories
+					EntryArray_push(collections, full_path, ENTRY_DIR); // yes, collections are fake directories
 				}
 				EntryArray_sort(collections);
 				for (int i=0; i<collections->count; i++) {
-					Array_push(entries, collections->items[i]);
+					EntryArray_append(entries, collections, &collections->items[i]);
 				}
-				Array_free(collections); // just free the array part, entries now owns collections entries
+				EntryArray_free(collections);
 				closedir(dh);
 			}
 		}
@@ -723,17 +916,17 @@ static Array* getRoot(void) {
 	
 	// add systems to root
 	for (int i=0; i<entries->count; i++) {
-		Array_push(root, entries->items[i]);
+		EntryArray_append(root, entries, &entries->items[i]);
 	}
-	Array_free(entries); // root now owns entries' entries
+	EntryArray_free(entries);
 	
 	char* tools_path = SDCARD_PATH "/Tools/" PLATFORM;
-	if (exists(tools_path)) Array_push(root, Entry_new(tools_path, ENTRY_DIR));
+	if (exists(tools_path)) EntryArray_push(root, tools_path, ENTRY_DIR);
 	
 	return root;
 }
-static Array* getRecents(void) {
-	Array* entries = Array_new();
+static EntryArray* getRecents(void) {
+	EntryArray* entries = EntryArray_new();
 	for (int i=0; i<recents->count; i++) {
 		Recent* recent = recents->items[i];
 		if (!recent->available) continue;
@@ -741,12 +934,12 @@ static Array* getRecents(void) {
 		char sd_path[256];
 		sprintf(sd_path, "%s%s", SDCARD_PATH, recent->path);
 		int type = suffixMatch(".pak", sd_path) ? ENTRY_PAK : ENTRY_ROM; // ???
-		Array_push(entries, Entry_new(sd_path, type));
+		EntryArray_push(entries, sd_path, type);
 	}
 	return entries;
 }
-static Array* getFavorites(void) {
-	Array* entries = Array_new();
+static EntryArray* getFavorites(void) {
+	EntryArray* entries = EntryArray_new();
 	for (int i=0; i<favorites->count; i++) {
 		Favorite* favorite = favorites->items[i];
 		if (!favorite->available) continue;
@@ -754,12 +947,12 @@ static Array* getFavorites(void) {
 		char sd_path[256];
 		sprintf(sd_path, "%s%s", SDCARD_PATH, favorite->path);
 		int type = suffixMatch(".pak", sd_path) ? ENTRY_PAK : ENTRY_ROM; // ???
-		Array_push(entries, Entry_new(sd_path, type));
+		EntryArray_push(entries, sd_path, type);
 	}
 	return entries;
 }
-static Array* getCollection(char* path) {
-	Array* entries = Array_new();
+static EntryArray* getCollection(char* path) {
+	EntryArray* entries = EntryArray_new();
 	FILE* file = fopen(path, "r");
 	if (file) {
 		char line[256];
@@ -772,12 +965,12 @@ static Array* getCollection(char* path) {
 			sprintf(sd_path, "%s%s", SDCARD_PATH, line);
 			if (exists(sd_path)) {
 				int type = suffixMatch(".pak", sd_path) ? ENTRY_PAK : ENTRY_ROM; // ???
-				Array_push(entries, Entry_new(sd_path, type));
+				EntryArray_push(entries, sd_path, type);
 				
 				// char emu_name[256];
 				// getEmuName(sd_path, emu_name);
 				// if (hasEmu(emu_name)) {
-					// Array_push(entries, Entry_new(sd_path, ENTRY_ROM));
+					// EntryArray_push(entries, sd_path, ENTRY_ROM);
 				// }
 			}
 		}
@@ -785,11 +978,11 @@ static Array* getCollection(char* path) {
 	}
 	return entries;
 }
-static Array* getDiscs(char* path){
+static EntryArray* getDiscs(char* path){
 	
 	// TODO: does path have SDCARD_PATH prefix?
 	
-	Array* entries = Array_new();
+	EntryArray* entries = EntryArray_new();
 	
 	char base_path[256];
 	strcpy(base_path, path);
@@ -811,12 +1004,9 @@ static Array* getDiscs(char* path){
 						
 			if (exists(disc_path)) {
 				disc += 1;
-				Entry* entry = Entry_new(disc_path, ENTRY_ROM);
-				free(entry->name);
 				char name[16];
 				sprintf(name, "Disc %i", disc);
-				entry->name = strdup(name);
-				Array_push(entries, entry);
+				EntryArray_pushNamed(entries, disc_path, name, ENTRY_ROM);
 			}
 		}
 		fclose(file);
@@ -849,7 +1039,9 @@ static int getFirstDisc(char* m3u_path, char* disc_path) { // based on getDiscs(
 	return found;
 }
 
-static void addEntries(Array* entries, char* path) {
+static void DirectoryLoader_add(DirectoryLoader* self, EntryArray* entries);
+static void DirectoryLoader_publish(DirectoryLoader* self, EntryArray* entries, int force);
+static void addEntries(EntryArray* entries, char* path, DirectoryLoader* loader) {
 	DIR *dh = opendir(path);
 	if (dh!=NULL) {
 		struct dirent *dp;
@@ -858,6 +1050,7 @@ static void addEntries(Array* entries, char* path) {
 		sprintf(full_path, "%s/", path);
 		tmp = full_path + strlen(full_path);
 		while((dp = readdir(dh)) != NULL) {
+			if (loader && loader->cancel) break;
 			if (hide(dp->d_name)) continue;
 			strcpy(tmp, dp->d_name);
 			int is_dir = dp->d_type==DT_DIR;
@@ -879,7 +1072,8 @@ static void addEntries(Array* entries, char* path) {
 					type = ENTRY_ROM;
 				}
 			}
-			Array_push(entries, Entry_new(full_path, type));
+			EntryArray_push(entries, full_path, type);
+			if (loader) DirectoryLoader_add(loader, entries);
 		}
 		closedir(dh);
 	}
@@ -895,8 +1089,8 @@ static int isConsoleDir(char* path) {
 	return exactMatch(parent_dir, ROMS_PATH);
 }
 
-static Array* getEntries(char* path){
-	Array* entries = Array_new();
+static EntryArray* getEntries(char* path, Array* sources, DirectoryLoader* loader){ // sources and loader are optional, sources receives every folder read
+	EntryArray* entries = EntryArray_new();
 
 	if (isConsoleDir(path)) { // top-level console folder, might collate
 		char collated_path[256];
@@ -906,6 +1100,7 @@ static Array* getEntries(char* path){
 		// but conditional so we can continue to support a bare tag name as a folder name
 		if (tmp) tmp[1] = '\0'; 
 		
+		if (sources) Array_push(sources, strdup(ROMS_PATH)); // a new collated folder changes its mtime
 		DIR *dh = opendir(ROMS_PATH);
 		if (dh!=NULL) {
 			struct dirent *dp;
@@ -919,19 +1114,313 @@ static Array* getEntries(char* path){
 				strcpy(tmp, dp->d_name);
 			
 				if (!prefixMatch(collated_path, full_path)) continue;
-				addEntries(entries, full_path);
+				if (sources) Array_push(sources, strdup(full_path));
+				addEntries(entries, full_path, loader);
 			}
 			closedir(dh);
 		}
 	}
-	else addEntries(entries, path); // just a subfolder
+	else { // just a subfolder
+		if (sources) Array_push(sources, strdup(path));
+		addEntries(entries, path, loader);
+	}
 	
+	if (loader && !loader->cancel) DirectoryLoader_publish(loader, entries, 1); // the final first page, before the (slower) full sort
 	EntryArray_sort(entries);
 	return entries;
 }
 
 ///////////////////////////////////////
 
+// big folders are read on a thread, the main loop shows the first page
+// as it fills in and gets the real thing from Directory_poll() when done
+
+#define PREVIEW_INTERVAL 16667 // microseconds, about a frame
+
+static void DirectoryLoader_handoff(DirectoryLoader* self, EntryArray* entries, IntArray* alphas) {
+	pthread_mutex_lock(&self->lock);
+	if (self->entries) EntryArray_free(self->entries); // main thread never saw it
+	self->entries = entries;
+	if (alphas) {
+		self->alphas = alphas;
+		self->done = 1;
+	}
+	pthread_mutex_unlock(&self->lock);
+}
+static void DirectoryLoader_publish(DirectoryLoader* self, EntryArray* entries, int force) {
+	if (!self->changed) return;
+	uint64_t now = getMicroseconds();
+	if (!force && now-self->published_at<PREVIEW_INTERVAL) return;
+	
+	EntryArray* preview = EntryArray_new();
+	for (int i=0; i<self->row_count; i++) {
+		EntryArray_append(preview, entries, &entries->items[self->rows[i]]);
+	}
+	DirectoryLoader_handoff(self, preview, NULL);
+	self->changed = 0;
+	self->published_at = now;
+}
+static void DirectoryLoader_add(DirectoryLoader* self, EntryArray* entries) { // called for each new (last) entry
+	int i = entries->count - 1;
+	char* name = EntryArray_name(entries, &entries->items[i]);
+	
+	// insert into the first page if it sorts before what we have
+	int at = self->row_count;
+	while (at>0 && strcasecmp(name, EntryArray_name(entries, &entries->items[self->rows[at-1]]))<0) at -= 1;
+	if (at>=MAIN_ROW_COUNT) return;
+	
+	if (self->row_count<MAIN_ROW_COUNT) self->row_count += 1;
+	for (int j=self->row_count-1; j>at; j--) {
+		self->rows[j] = self->rows[j-1];
+	}
+	self->rows[at] = i;
+	self->changed = 1;
+	DirectoryLoader_publish(self, entries, 0);
+}
+
+static void* DirectoryLoader_run(void* arg) {
+	TRACE_SCOPE("DirectoryLoader_run");
+	DirectoryLoader* self = arg;
+	
+	Array* sources = Array_new(); // folders the index depends on
+	EntryArray* entries = getEntries(self->path, sources, self);
+	if (self->cancel) {
+		EntryArray_free(entries);
+		StringArray_free(sources);
+		return NULL;
+	}
+	
+	IntArray* alphas = IntArray_new();
+	indexEntries(self->path, entries, alphas);
+	Index_save(self->path, entries, alphas, sources);
+	StringArray_free(sources);
+	
+	DirectoryLoader_handoff(self, entries, alphas);
+	return NULL;
+}
+
+static DirectoryLoader* DirectoryLoader_new(char* path) {
+	DirectoryLoader* self = calloc(1, sizeof(DirectoryLoader));
+	self->path = strdup(path);
+	pthread_mutex_init(&self->lock, NULL);
+	pthread_create(&self->thread, NULL, DirectoryLoader_run, self);
+	return self;
+}
+static void DirectoryLoader_free(DirectoryLoader* self) {
+	self->cancel = 1;
+	pthread_join(self->thread, NULL);
+	if (self->entries) EntryArray_free(self->entries);
+	if (self->alphas) IntArray_free(self->alphas);
+	pthread_mutex_destroy(&self->lock);
+	free(self->path);
+	free(self);
+}
+
+static int Directory_poll(Directory* self) { // main thread only, returns 1 if entries changed
+	DirectoryLoader* loader = self->loader;
+	if (!loader) return 0;
+	
+	pthread_mutex_lock(&loader->lock);
+	EntryArray* entries = loader->entries;
+	IntArray* alphas = loader->alphas;
+	int done = loader->done;
+	loader->entries = NULL;
+	loader->alphas = NULL;
+	pthread_mutex_unlock(&loader->lock);
+	
+	if (!entries) return 0;
+	EntryArray_free(self->entries);
+	self->entries = entries;
+	if (!done) return 1;
+	
+	IntArray_free(self->alphas);
+	self->alphas = alphas;
+	DirectoryLoader_free(loader); // thread is already finishing up
+	self->loader = NULL;
+	
+	// restore the selection openDirectory() asked for
+	int total = self->entries->count;
+	if (self->selected>=total) {
+		self->selected = 0;
+		self->start = 0;
+		self->restore_end = 0;
+	}
+	self->end = self->restore_end ? self->restore_end : ((total<MAIN_ROW_COUNT) ? total : MAIN_ROW_COUNT);
+	if (self->end>total) self->end = total;
+	return 1;
+}
+static void Directory_wait(Directory* self) {
+	while (self->loader) {
+		if (!Directory_poll(self)) usleep(1000);
+	}
+}
+
+///////////////////////////////////////
+
+// sorted and indexed folder listings are cached on the card so we
+// only have to readdir/getDisplayName/sort again when a folder changes
+// layout: IndexHeader, IndexSource[source_count], Entry[entry_count], int32_t[alpha_count], strings
+// strings is the EntryArray's arena as-is followed by the key and source paths
+
+#define INDEX_MAGIC 0x5849554d // "MUIX"
+#define INDEX_VERSION 2
+#define INDEX_MTIME_SLOP 2 // seconds, FAT mtimes only have a 2 second resolution
+
+typedef struct IndexHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key; // offset in strings of the Directory path
+	uint32_t source_count;
+	uint32_t entry_count;
+	uint32_t alpha_count;
+	uint32_t strings_size;
+} IndexHeader;
+typedef struct IndexSource {
+	int64_t mtime;
+	uint32_t path;
+} IndexSource;
+
+static void getIndexPath(char* dir_path, char* index_path) {
+	uint32_t hash = 5381; // djb2
+	for (char* c=dir_path; *c; c++) hash = ((hash << 5) + hash) + (uint8_t)*c;
+	sprintf(index_path, "%s/%08x.idx", INDEX_PATH, hash);
+}
+
+static int Index_load(Directory* self) {
+	char index_path[256];
+	getIndexPath(self->path, index_path);
+	
+	int fd = open(index_path, O_RDONLY);
+	if (fd<0) return 0;
+	struct stat st;
+	if (fstat(fd, &st)!=0 || st.st_size<sizeof(IndexHeader)) {
+		close(fd);
+		return 0;
+	}
+	size_t size = st.st_size;
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map==MAP_FAILED) return 0;
+	
+	int loaded = 0;
+	IndexHeader* header = map;
+	IndexSource* sources = (IndexSource*)(header + 1);
+	Entry* items = (Entry*)(sources + header->source_count);
+	int32_t* alphas = (int32_t*)(items + header->entry_count);
+	char* strings = (char*)(alphas + header->alpha_count);
+	uint32_t strings_size = header->strings_size;
+	
+	uint64_t expected = sizeof(IndexHeader)
+		+ (uint64_t)header->source_count * sizeof(IndexSource)
+		+ (uint64_t)header->entry_count * sizeof(Entry)
+		+ (uint64_t)header->alpha_count * sizeof(int32_t)
+		+ strings_size;
+	
+	#define VALID_STRING(offset,len) ((uint64_t)(offset)+(len)<strings_size && strings[(offset)+(len)]=='\0')
+	if (header->magic!=INDEX_MAGIC || header->version!=INDEX_VERSION) goto done;
+	if (expected!=size || strings_size==0 || strings[0]!='\0' || strings[strings_size-1]!='\0') goto done;
+	if (header->alpha_count>INT_ARRAY_MAX || header->source_count==0) goto done;
+	if (header->key>=strings_size || !exactMatch(strings+header->key, self->path)) goto done; // hash collision
+	
+	// stale?
+	for (int i=0; i<header->source_count; i++) {
+		IndexSource* source = &sources[i];
+		if (source->path>=strings_size) goto done;
+		if (stat(strings+source->path, &st)!=0 || st.st_mtime!=source->mtime) goto done;
+	}
+	for (int i=0; i<header->entry_count; i++) {
+		Entry* item = &items[i];
+		if (!VALID_STRING(item->path,item->path_len) || !VALID_STRING(item->name,item->name_len) || !VALID_STRING(item->unique,item->unique_len)) goto done;
+		if (header->alpha_count ? item->alpha>=header->alpha_count : item->alpha!=0) goto done;
+	}
+	#undef VALID_STRING
+	
+	// two copies and we're done
+	EntryArray* entries = malloc(sizeof(EntryArray));
+	entries->count = header->entry_count;
+	entries->capacity = entries->count ? entries->count : 1;
+	entries->items = malloc(sizeof(Entry) * entries->capacity);
+	memcpy(entries->items, items, sizeof(Entry) * entries->count);
+	entries->strings_size = strings_size;
+	entries->strings_capacity = strings_size;
+	entries->strings = malloc(strings_size);
+	memcpy(entries->strings, strings, strings_size);
+	self->entries = entries;
+	
+	for (int i=0; i<header->alpha_count; i++) {
+		IntArray_push(self->alphas, alphas[i]);
+	}
+	loaded = 1;
+done:
+	munmap(map, size);
+	return loaded;
+}
+
+static void Index_save(char* path, EntryArray* entries, IntArray* alphas, Array* sources) {
+	IndexHeader header;
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.source_count = sources->count;
+	header.entry_count = entries->count;
+	header.alpha_count = alphas->count;
+	
+	IndexSource* index_sources = calloc(sources->count+1, sizeof(IndexSource)); // zeroes the tail padding that gets written too
+	time_t now = time(NULL);
+	for (int i=0; i<sources->count; i++) {
+		struct stat st;
+		if (stat(sources->items[i], &st)!=0) goto cleanup;
+		// a change within the same tick would go unnoticed, try again next time
+		if (now-st.st_mtime<INDEX_MTIME_SLOP) goto cleanup;
+		index_sources[i].mtime = st.st_mtime;
+	}
+	
+	// key and source paths go after the arena
+	uint32_t offset = entries->strings_size;
+	header.key = offset;
+	offset += strlen(path) + 1;
+	for (int i=0; i<sources->count; i++) {
+		index_sources[i].path = offset;
+		offset += strlen(sources->items[i]) + 1;
+	}
+	header.strings_size = offset;
+	
+	int32_t index_alphas[INT_ARRAY_MAX];
+	for (int i=0; i<alphas->count; i++) {
+		index_alphas[i] = alphas->items[i];
+	}
+	
+	mkdir(USERDATA_PATH "/.minui", 0755);
+	mkdir(INDEX_PATH, 0755);
+	
+	char index_path[256];
+	char tmp_path[256];
+	getIndexPath(path, index_path);
+	sprintf(tmp_path, "%s.tmp", index_path);
+	
+	FILE* file = fopen(tmp_path, "wb");
+	if (file) {
+		int ok = 1;
+		ok = ok && fwrite(&header, sizeof(IndexHeader), 1, file)==1;
+		ok = ok && fwrite(index_sources, sizeof(IndexSource), sources->count, file)==sources->count;
+		ok = ok && fwrite(entries->items, sizeof(Entry), entries->count, file)==entries->count;
+		ok = ok && fwrite(index_alphas, sizeof(int32_t), alphas->count, file)==alphas->count;
+		ok = ok && fwrite(entries->strings, 1, entries->strings_size, file)==entries->strings_size;
+		ok = ok && fwrite(path, strlen(path)+1, 1, file)==1;
+		for (int i=0; i<sources->count; i++) {
+			char* source = sources->items[i];
+			ok = ok && fwrite(source, strlen(source)+1, 1, file)==1;
+		}
+		ok = fclose(file)==0 && ok;
+		if (ok) rename(tmp_path, index_path); // never leave a partial index behind
+		else unlink(tmp_path);
+	}
+	
+cleanup:
+	free(index_sources);
+}
+
+///////////////////////////////////////
+
 static void queueNext(char* cmd) {
 	putFile("/tmp/next", cmd);
 	quit = 1;
@@ -1006,8 +1495,8 @@ static void readyResumePath(char* rom_path, int type) {
 	
 	can_resume = exists(slot_path);
 }
-static void readyResume(Entry* entry) {
-	readyResumePath(entry->path, entry->type);
+static void readyResume(EntryArray* entries, Entry* entry) {
+	readyResumePath(EntryArray_path(entries, entry), entry->type);
 }
 
 static void saveLast(char* path);
@@ -1105,7 +1594,9 @@ static void openRom(char* path, char* last) {
 	else putInt(RESUME_SLOT_PATH,8); // resume hidden default state
 	
 	char emu_path[256];
-	getEmuPath(emu_name, emu_path);
+	char* pak_path = getEmuPak(emu_name);
+	if (pak_path) strcpy(emu_path, pak_path);
+	else getEmuPath(emu_name, emu_path);
 	
 	// NOTE: escapeSingleQuotes() modifies the passed string 
 	// so we need to save the path before we call that
@@ -1150,6 +1641,7 @@ static void openDirectory(char* path, int auto_launch) {
 	top = Directory_new(path, selected);
 	top->start = start;
 	top->end = end ? end : ((top->entries->count<MAIN_ROW_COUNT) ? top->entries->count : MAIN_ROW_COUNT);
+	top->restore_end = end; // in case it's still loading
 
 	Array_push(stack, top);
 }
@@ -1163,27 +1655,31 @@ static void closeDirectory(void) {
 	restore_relative = top->selected;
 }
 
-static void Entry_open(Entry* self) {
+static void Entry_open(EntryArray* entries, Entry* self) {
+	// NOTE: copied because escapeSingleQuotes() modifies (and can lengthen) the passed string
+	char path[256];
+	strcpy(path, EntryArray_path(entries, self));
+	
 	if (self->type==ENTRY_ROM) {
 		char *last = NULL;
 		if (prefixMatch(COLLECTIONS_PATH, top->path)) {
 			char* tmp;
 			char filename[256];
 			
-			tmp = strrchr(self->path, '/');
+			tmp = strrchr(path, '/');
 			if (tmp) strcpy(filename, tmp+1);
 			
 			char last_path[256];
 			sprintf(last_path, "%s/%s", top->path, filename);
 			last = last_path;
 		}
-		openRom(self->path, last);
+		openRom(path, last);
 	}
 	else if (self->type==ENTRY_PAK) {
-		openPak(self->path);
+		openPak(path);
 	}
 	else if (self->type==ENTRY_DIR) {
-		openDirectory(self->path, 1);
+		openDirectory(path, 1);
 	}
 }
 
@@ -1202,6 +1698,7 @@ static void saveLast(char* path) {
 	putFile(LAST_PATH, path);
 }
 static void loadLast(void) { // call after loading root directory
+	TRACE_SCOPE("loadLast");
 	if (!exists(LAST_PATH)) return;
 
 	char last_path[256];
@@ -1234,11 +1731,19 @@ static void loadLast(void) { // call after loading root directory
 				if (tmp) tmp[1] = '\0'; // 1 because we want to keep the opening parenthesis to avoid collating "Game Boy Color" and "Game Boy Advance" into "Game Boy"
 			}
 			
-			for (int i=0; i<top->entries->count; i++) {
-				Entry* entry = top->entries->items[i];
+			Directory_wait(top); // we need all the entries
+			
+			int i = 0;
+			if (!strlen(collated_path) && !prefixMatch(COLLECTIONS_PATH, full_path)) { // only an exact match will do
+				i = Directory_indexOf(top, path);
+				if (i==-1) i = top->entries->count; // not here
+			}
+			for (; i<top->entries->count; i++) {
+				Entry* entry = &top->entries->items[i];
+				char* entry_path = EntryArray_path(top->entries, entry);
 			
 				// NOTE: strlen() is required for collated_path, '\0' wasn't reading as NULL for some reason
-				if (exactMatch(entry->path, path) || (strlen(collated_path) && prefixMatch(collated_path, entry->path)) || (prefixMatch(COLLECTIONS_PATH, full_path) && suffixMatch(filename, entry->path))) {
+				if (exactMatch(entry_path, path) || (strlen(collated_path) && prefixMatch(collated_path, entry_path)) || (prefixMatch(COLLECTIONS_PATH, full_path) && suffixMatch(filename, entry_path))) {
 					top->selected = i;
 					if (i>=top->end) {
 						top->start = i;
@@ -1248,10 +1753,10 @@ static void loadLast(void) { // call after loading root directory
 							top->start = top->end - MAIN_ROW_COUNT;
 						}
 					}
-					if (last->count==0 && !exactMatch(entry->path, FAUX_RECENT_PATH) && !(!exactMatch(entry->path, COLLECTIONS_PATH) && prefixMatch(COLLECTIONS_PATH, entry->path))) break; // don't show contents of auto-launch dirs
+					if (last->count==0 && !exactMatch(entry_path, FAUX_RECENT_PATH) && !(!exactMatch(entry_path, COLLECTIONS_PATH) && prefixMatch(COLLECTIONS_PATH, entry_path))) break; // don't show contents of auto-launch dirs
 				
 					if (entry->type==ENTRY_DIR) {
-						openDirectory(entry->path, 0);
+						openDirectory(entry_path, 0);
 						break;
 					}
 				}
@@ -1269,6 +1774,8 @@ static void Menu_init(void) {
 	stack = Array_new(); // array of open Directories
 	recents = Array_new();
 	favorites = Array_new();
+	recent_paths = StrMap_new(MAX_RECENTS);
+	favorite_paths = StrMap_new(0);
 
 	openDirectory(SDCARD_PATH, 0);
 	loadLast(); // restore state when available
@@ -1276,12 +1783,16 @@ static void Menu_init(void) {
 static void Menu_quit(void) {
 	RecentArray_free(recents);
 	FavoriteArray_free(favorites);
+	StrMap_free(recent_paths);
+	StrMap_free(favorite_paths);
+	if (emu_paks) Hash_free(emu_paks);
 	DirectoryArray_free(stack);
 }
 
 ///////////////////////////////////////
 
 int main (int argc, char *argv[]) {
+	TRACE_INIT("minui");
 	if (autoResume()) return 0; // nothing to do
 	
 	LOG_info("FinUI\n");
@@ -1300,6 +1811,8 @@ int main (int argc, char *argv[]) {
 	GFX_setVsync(VSYNC_STRICT);
 
 	PAD_reset();
+	TRACE_BEGIN("first frame");
+	int first_frame = 1;
 	int dirty = 1;
 	int show_version = 0;
 	int show_setting = 0; // 1=brightness,2=volume
@@ -1308,6 +1821,9 @@ int main (int argc, char *argv[]) {
 		unsigned long now = SDL_GetTicks();
 		
 		PAD_poll();
+		
+		if (Directory_poll(top)) dirty = 1;
+		int loading = top->loader!=NULL; // entries is just the first page so far
 			
 		int selected = top->selected;
 		int total = top->entries->count;
@@ -1323,7 +1839,7 @@ int main (int argc, char *argv[]) {
 				show_version = 1;
 				dirty = 1;
 			}
-			else if (total>0) {
+			else if (total>0 && !loading) {
 				if (PAD_justRepeated(BTN_UP)) {
 					if (selected==0 && !PAD_justPressed(BTN_UP)) {
 						// stop at top
@@ -1388,8 +1904,11 @@ int main (int argc, char *argv[]) {
 				}
 			}
 		
-			if (PAD_justRepeated(BTN_L1)) { // previous alpha
-				Entry* entry = top->entries->items[selected];
+			if (loading) {
+				// wait for it
+			}
+			else if (PAD_justRepeated(BTN_L1)) { // previous alpha
+				Entry* entry = &top->entries->items[selected];
 				int i = entry->alpha-1;
 				if (i>=0) {
 					selected = top->alphas->items[i];
@@ -1402,7 +1921,7 @@ int main (int argc, char *argv[]) {
 				}
 			}
 			else if (PAD_justRepeated(BTN_R1)) { // next alpha
-				Entry* entry = top->entries->items[selected];
+				Entry* entry = &top->entries->items[selected];
 				int i = entry->alpha+1;
 				if (i<top->alphas->count) {
 					selected = top->alphas->items[i];
@@ -1420,31 +1939,32 @@ int main (int argc, char *argv[]) {
 				dirty = 1;
 			}
 	
-			if (dirty && total>0) readyResume(top->entries->items[top->selected]);
+			if (dirty && total>0 && !loading) readyResume(top->entries, &top->entries->items[top->selected]);
+			if (loading) can_resume = 0;
 
-			if (total>0 && can_resume && PAD_justReleased(BTN_RESUME)) {
+			if (total>0 && !loading && can_resume && PAD_justReleased(BTN_RESUME)) {
 				should_resume = 1;
-				Entry_open(top->entries->items[top->selected]);
+				Entry_open(top->entries, &top->entries->items[top->selected]);
 				dirty = 1;
 			}
-			else if (total>0 && PAD_justPressed(BTN_B)) {
-				Entry_open(top->entries->items[top->selected]);
+			else if (total>0 && !loading && PAD_justPressed(BTN_B)) {
+				Entry_open(top->entries, &top->entries->items[top->selected]);
 				total = top->entries->count;
 				dirty = 1;
 
-				if (total>0) readyResume(top->entries->items[top->selected]);
+				if (total>0 && !top->loader) readyResume(top->entries, &top->entries->items[top->selected]);
 			}
 			else if (PAD_justPressed(BTN_A) && stack->count>1) {
 				closeDirectory();
 				total = top->entries->count;
 				dirty = 1;
 				// can_resume = 0;
-				if (total>0) readyResume(top->entries->items[top->selected]);
+				if (total>0 && !top->loader) readyResume(top->entries, &top->entries->items[top->selected]);
 			}
-			else if (total>0 && PAD_justPressed(BTN_SELECT)) {
-				Entry* entry = top->entries->items[top->selected];
+			else if (total>0 && !loading && PAD_justPressed(BTN_SELECT)) {
+				Entry* entry = &top->entries->items[top->selected];
 				if (entry->type == ENTRY_ROM) {
-					toggleFavorite(entry->path);
+					toggleFavorite(EntryArray_path(top->entries, entry));
 					dirty = 1;
 				}
 			}
@@ -1475,13 +1995,13 @@ int main (int argc, char *argv[]) {
 					char* extra_key = "Model";
 					char* extra_val = "Anbernic RG35XX";
 					
-					SDL_Surface* release_txt = TTF_RenderUTF8_Blended(font.large, "Release", COLOR_DARK_TEXT);
-					SDL_Surface* version_txt = TTF_RenderUTF8_Blended(font.large, release, COLOR_WHITE);
-					SDL_Surface* commit_txt = TTF_RenderUTF8_Blended(font.large, "Commit", COLOR_DARK_TEXT);
-					SDL_Surface* hash_txt = TTF_RenderUTF8_Blended(font.large, commit, COLOR_WHITE);
+					SDL_Surface* release_txt = GFX_renderText(font.large, "Release", COLOR_DARK_TEXT);
+					SDL_Surface* version_txt = GFX_renderText(font.large, release, COLOR_WHITE);
+					SDL_Surface* commit_txt = GFX_renderText(font.large, "Commit", COLOR_DARK_TEXT);
+					SDL_Surface* hash_txt = GFX_renderText(font.large, commit, COLOR_WHITE);
 					
-					SDL_Surface* key_txt = TTF_RenderUTF8_Blended(font.large, extra_key, COLOR_DARK_TEXT);
-					SDL_Surface* val_txt = TTF_RenderUTF8_Blended(font.large, extra_val, COLOR_WHITE);
+					SDL_Surface* key_txt = GFX_renderText(font.large, extra_key, COLOR_DARK_TEXT);
+					SDL_Surface* val_txt = GFX_renderText(font.large, extra_val, COLOR_WHITE);
 					
 					int l_width = 0;
 					int r_width = 0;
@@ -1531,16 +2051,20 @@ int main (int argc, char *argv[]) {
 			else {
 				// list
 				if (total>0) {
-					int selected_row = top->selected - top->start;
-					for (int i=top->start,j=0; i<top->end; i++,j++) {
-						Entry* entry = top->entries->items[i];
-						char* entry_name = entry->name;
-						char* entry_unique = entry->unique;
+					// while loading there's only the first page and nothing is selectable yet
+					int row_start = loading ? 0 : top->start;
+					int row_end = loading ? total : top->end;
+					int selected_row = loading ? -1 : top->selected - top->start;
+					for (int i=row_start,j=0; i<row_end; i++,j++) {
+						Entry* entry = &top->entries->items[i];
+						char* entry_path = EntryArray_path(top->entries, entry);
+						char* entry_name = EntryArray_name(top->entries, entry);
+						char* entry_unique = EntryArray_unique(top->entries, entry);
 						int available_width = screen->w - SCALE1(PADDING * 2);
-						if (i==top->start) available_width -= ow;
+						if (i==row_start) available_width -= ow;
 					
 						SDL_Color text_color = COLOR_WHITE;
-						// if (isFavorite(entry->path)) {
+						// if (isFavorite(entry_path)) {
 						// 	text_color = COLOR_GOLD;
 						// }
 					
@@ -1548,7 +2072,7 @@ int main (int argc, char *argv[]) {
 					
 						char display_name[256];
 						char calculated_name[256] = "*";
-                        if (isFavorite(entry->path)) {
+                        if (isFavorite(entry_path)) {
 							strcat(calculated_name, entry_unique ? entry_unique : entry_name);
 						} else {
 							strcpy(calculated_name, entry_unique ? entry_unique : entry_name);
@@ -1563,16 +2087,16 @@ int main (int argc, char *argv[]) {
 								SCALE1(PILL_SIZE)
 							});
 							text_color = COLOR_BLACK;
-							// if (isFavorite(entry->path)) {
+							// if (isFavorite(entry_path)) {
 							// 	text_color = COLOR_GOLD;
 							// }
 						}
-						else if (entry->unique) {
+						else if (entry_unique) {
 							trimSortingMeta(&entry_unique);
 							char unique_name[256];
 							GFX_truncateText(font.large, entry_unique, unique_name, available_width, SCALE1(BUTTON_PADDING*2));
 						
-							SDL_Surface* text = TTF_RenderUTF8_Blended(font.large, unique_name, COLOR_DARK_TEXT);
+							SDL_Surface* text = GFX_getText(font.large, unique_name, COLOR_DARK_TEXT);
 							SDL_BlitSurface(text, &(SDL_Rect){
 								0,
 								0,
@@ -1585,7 +2109,7 @@ int main (int argc, char *argv[]) {
 						
 							GFX_truncateText(font.large, entry_name, display_name, available_width, SCALE1(BUTTON_PADDING*2));
 						}
-						SDL_Surface* text = TTF_RenderUTF8_Blended(font.large, display_name, text_color);
+						SDL_Surface* text = GFX_getText(font.large, display_name, text_color);
 						SDL_BlitSurface(text, &(SDL_Rect){
 							0,
 							0,
@@ -1595,11 +2119,10 @@ int main (int argc, char *argv[]) {
 							SCALE1(PADDING+BUTTON_PADDING),
 							SCALE1(PADDING+(j*PILL_SIZE)+4)
 						});
-						SDL_FreeSurface(text);
 					}
 				}
 				else {
-					GFX_blitMessage(font.large, "Empty folder", screen, NULL);
+					GFX_blitMessage(font.large, loading ? "Loading..." : "Empty folder", screen, NULL);
 				}
 			
 				// buttons
@@ -1631,8 +2154,17 @@ int main (int argc, char *argv[]) {
 
 			GFX_flip(screen);
 			dirty = 0;
+			
+			if (first_frame) {
+				TRACE_END("first frame");
+				first_frame = 0;
+#ifdef BENCH
+				quit = 1; // only measuring boot to menu
+#endif
+			}
 		}
-		else GFX_sync();
+		else if (loading) GFX_sync(); // keep polling the loader
+		else GFX_idle();
 	}
 	
 	if (version) SDL_FreeSurface(version);